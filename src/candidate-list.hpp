@@ -63,6 +63,16 @@ class CandidateList : public CandidateListBase,
         return CandidateListKind::CandidateList;
     }
 
+    auto load_until(const size_t size) -> void {
+        if(!candidates->has_more()) {
+            return;
+        }
+        candidates->load_more(size);
+        for(auto& label : candidates->get_labels(words.size())) {
+            words.emplace_back(std::make_unique<CandidateWord>(fcitx::Text(std::move(label))));
+        }
+    }
+
   public:
     // CandidateList
     auto label(const int idx) const -> const fcitx::Text& override {
@@ -90,18 +100,20 @@ class CandidateList : public CandidateListBase,
     }
 
     auto hasNext() const -> bool override {
-        return currentPage() + 1 < totalPages();
+        return currentPage() + 1 < totalPages() || candidates->has_more();
     }
 
     auto prev() -> void override {
         if(hasPrev()) {
             candidates->set_index_wrapped((currentPage() - 1) * page_size);
-        } else {
+        } else if(!candidates->has_more()) {
+            // wrapping while more can be loaded would skip them
             candidates->set_index_wrapped((totalPages() - 1) * page_size);
         }
     }
 
     auto next() -> void override {
+        load_until((currentPage() + 2) * page_size);
         if(hasNext()) {
             candidates->set_index_wrapped((currentPage() + 1) * page_size);
         } else {
@@ -123,19 +135,26 @@ class CandidateList : public CandidateListBase,
     }
 
     auto setPage(int page) -> void override {
+        load_until((page + 1) * page_size);
         candidates->set_index_wrapped(page * page_size);
     }
 
     // CursorMovableCandidateList
     auto prevCandidate() -> void override {
         if(candidates->index == 0) {
-            candidates->index = candidates->get_data_size() - 1;
+            // the last one is unknown while more can be loaded
+            if(!candidates->has_more()) {
+                candidates->index = candidates->get_data_size() - 1;
+            }
         } else {
             candidates->index -= 1;
         }
     }
 
     auto nextCandidate() -> void override {
+        if(candidates->index + 1 >= candidates->get_data_size()) {
+            load_until(candidates->get_data_size() + page_size);
+        }
         candidates->set_index_wrapped(candidates->index + 1);
     }
 
@@ -144,8 +163,8 @@ class CandidateList : public CandidateListBase,
           page_size(page_size) {
         setPageable(this);
         setCursorMovable(this);
-        for(const auto& w : candidates->get_labels()) {
-            words.emplace_back(std::make_unique<CandidateWord>(fcitx::Text(w)));
+        for(auto& label : candidates->get_labels(0)) {
+            words.emplace_back(std::make_unique<CandidateWord>(fcitx::Text(std::move(label))));
         }
     }
 };
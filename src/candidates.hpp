@@ -9,8 +9,16 @@ struct Candidates {
         index = val % get_data_size();
     }
 
-    virtual auto get_data_size() const -> size_t                = 0;
-    virtual auto get_labels() const -> std::vector<std::string> = 0;
+    virtual auto get_data_size() const -> size_t = 0;
+    // labels of the candidates from first, so that lazily loaded ones can be appended
+    virtual auto get_labels(size_t first) const -> std::vector<std::string> = 0;
+
+    // for lazily generated candidates
+    virtual auto has_more() const -> bool {
+        return false;
+    }
+    // make at least size candidates available, if possible
+    virtual auto load_more(const size_t /*size*/) -> void {}
 
     Candidates()          = default;
     virtual ~Candidates() = default;
@@ -5,6 +5,7 @@
 #include "macros/unwrap.hpp"
 #include "misc.hpp"
 #include "romaji-index.hpp"
+#include "utf8.hpp"
 
 namespace mikan {
 auto Command::show_message(std::string message) -> void {
@@ -31,7 +32,7 @@ struct KanaArgumentCommand : Command {
                 break;
             }
             if(!to_kana.empty()) {
-                pop_back_u8(to_kana);
+                utf8::pop_back(to_kana);
                 goto end;
             }
             if(raw.empty()) {
@@ -39,13 +40,11 @@ struct KanaArgumentCommand : Command {
             }
 
             // delete character from the word
-            const auto back = pop_back_u8(raw);
+            const auto back = utf8::pop_back(raw);
             // try to disassemble the kana character into romaji
-            auto kana8 = std::array<char, FCITX_UTF8_MAX_LENGTH>();
-            fcitx_ucs4_to_utf8(back, kana8.data());
-            if(auto romaji = kana_to_romaji(kana8.data())) {
-                to_kana = std::move(*romaji);
-                pop_back_u8(to_kana);
+            if(const auto romaji = kana_to_romaji(back)) {
+                to_kana = *romaji;
+                utf8::pop_back(to_kana);
             }
             goto end;
         } while(0);
@@ -184,7 +183,12 @@ auto Context::handle_key_event_command(fcitx::KeyEvent& event) -> void {
             break;
         }
         if(ctx.command == "/reload") {
-            engine.compile_and_reload_user_dictionary();
+            engine.compile_and_reload_user_dictionary_background();
+            exit_command_mode();
+        } else if(ctx.command == "/stats") {
+            const auto stats = engine.get_conversion_cache_stats();
+            share.instance->showCustomInputMethodInformation(&context, std::format("conversion cache: {} hits, {} misses, {} evictions, {} entries, {} KiB",
+                                                                                   stats.hits, stats.misses, stats.evictions, stats.entries, stats.bytes / 1024));
             exit_command_mode();
         } else {
             share.instance->showCustomInputMethodInformation(&context, "unknown command");
@@ -199,7 +203,7 @@ auto Context::handle_key_event_command(fcitx::KeyEvent& event) -> void {
             break;
         }
         if(!ctx.command.empty()) {
-            pop_back_u8(ctx.command);
+            utf8::pop_back(ctx.command);
         }
         if(ctx.command.empty()) {
             exit_command_mode();
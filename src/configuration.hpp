@@ -24,6 +24,11 @@ enum class Actions : size_t {
     GiveToLeft,
     GiveToRight,
     ConvertKatakana,
+    ConvertChainHiragana,
+    ConvertChainKatakana,
+    ConvertChainHalfKatakana,
+    ConvertChainFullAscii,
+    Predict,
     EnterCommandMode,
     ExitCommandMode,
     ActionsLimit,
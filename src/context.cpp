@@ -1,8 +1,10 @@
 #include "context.hpp"
 #include "candidate-list.hpp"
+#include "kana.hpp"
 #include "macros/assert.hpp"
 #include "misc.hpp"
 #include "romaji-table.hpp"
+#include "utf8.hpp"
 
 namespace mikan {
 namespace {
@@ -23,25 +25,16 @@ auto is_candidate_list_for(fcitx::InputContext& context, const Candidates* const
     return base->get_candidates() == candidates;
 }
 
-auto cursor_in_chars(const WordChain& chain, const size_t cursor) -> size_t {
-    auto count = 0uz;
-    for(auto i = 0uz; i < cursor; i += 1) {
-        count += u8tou32(chain[i].raw()).size();
-    }
-    return count;
+auto cursor_in_bytes(const WordChain& chain, const size_t cursor) -> size_t {
+    return ChainOffsets::from_chain(chain).begins[cursor];
 }
 
-auto cursor_in_words(const WordChain& chain, const size_t char_cursor) -> size_t {
-    auto cursor = 0uz;
-    auto count  = 0uz;
-    for(auto& word : chain) {
-        count += u8tou32(word.raw()).size();
-        if(count > char_cursor) {
-            return cursor;
-        }
-        cursor += 1;
+auto cursor_in_words(const WordChain& chain, const size_t byte_cursor) -> size_t {
+    const auto cursor = ChainOffsets::from_chain(chain).word_at(byte_cursor);
+    if(cursor >= chain.size()) {
+        PANIC("invalid word chain");
     }
-    PANIC("invalid word chain");
+    return cursor;
 }
 } // namespace
 
@@ -55,15 +48,20 @@ auto Context::get_current_chain() const -> const WordChain& {
 }
 
 auto Context::commit_word(const Word& word) -> void {
-    context.commitString(word.feature());
+    context.commitString(std::string(word.feature()));
+    engine.record_selection(last_commit, word);
+    last_commit = word.feature();
 }
 
 auto Context::commit_wordchain() -> void {
-    chains.reset({get_current_chain()});
+    chains.reset_to_current();
     for(const auto& word : get_current_chain()) {
         commit_word(word);
     }
     context.commitString(to_kana);
+    if(!to_kana.empty()) {
+        last_commit.clear();
+    }
     to_kana.clear();
 }
 
@@ -146,11 +144,15 @@ auto Context::auto_commit() -> void {
     const auto commit_num = chain.size() - share.auto_commit_threshold + 1;
     auto       on_holds   = 0uz;
     auto       commited   = false;
+    auto       erased     = 0uz;
+    // first words of the chain without each preceding words, from one analysis if possible
+    const auto heads = engine.convert_suffix_heads(chain, lattice);
     for(auto i = 0uz; i <= commit_num; i += 1) {
         // we have to ensure that the following word's translations will remain the same without this word
         if(chain[on_holds].protection != ProtectionLevel::PreserveTranslation) {
-            auto copy = engine.convert_wordchain(std::vector<Word>(chain.begin() + on_holds + 1, chain.end()), true)[0];
-            if(copy[0].feature() != chain[on_holds + 1].feature()) {
+            const auto next = erased + on_holds + 1;
+            const auto head = next < heads.size() ? heads[next] : engine.convert_wordchain(std::vector<Word>(chain.begin() + on_holds + 1, chain.end()))[0];
+            if(head.feature() != chain[on_holds + 1].feature()) {
                 // translation result will be changed
                 // but maybe we can commit this word with next one
                 on_holds += 1;
@@ -164,6 +166,7 @@ auto Context::auto_commit() -> void {
             chain.erase(chain.begin());
             cursor -= 1;
         }
+        erased += on_holds + 1;
         on_holds = 0;
         commited = true;
     }
@@ -172,6 +175,55 @@ auto Context::auto_commit() -> void {
     }
 }
 
+auto Context::update_background_conversion() -> void {
+    if(chains.empty() || chains.get_data_size() >= 2) {
+        if(background_conversion) {
+            background_conversion->cancel();
+            background_conversion.reset();
+        }
+        return;
+    }
+    const auto& chain = get_current_chain();
+    if(background_conversion) {
+        if(background_conversion->is_for(chain)) {
+            return;
+        }
+        background_conversion->cancel();
+    }
+    // prepare sentence candidates while the user is idle
+    background_conversion = engine.convert_wordchain_background(chain);
+}
+
+auto Context::update_candidate_prefetch() -> void {
+    if(chains.empty() || share.prefetch_budget == 0) {
+        candidate_prefetch->cancel();
+        prefetch_request.clear();
+        return;
+    }
+    const auto& chain = get_current_chain();
+
+    // the word under the cursor first, then its neighbours
+    auto       words   = std::vector<Word>();
+    auto       request = std::string();
+    const auto add     = [&](const size_t index) {
+        if(index >= chain.size() || chain[index].has_candidates()) {
+            return;
+        }
+        request += engine::CandidatePrefetch::key_of(chain[index]) + "\t";
+        words.emplace_back(chain[index]);
+    };
+    add(cursor);
+    for(auto distance = 1uz; distance <= share.prefetch_neighbours; distance += 1) {
+        add(cursor - distance);
+        add(cursor + distance);
+    }
+    if(request == prefetch_request) {
+        return;
+    }
+    prefetch_request = std::move(request);
+    engine.prefetch_candidates(candidate_prefetch, std::move(words));
+}
+
 auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
     using enum Actions;
     auto& panel  = context.inputPanel();
@@ -203,34 +255,17 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         if(chains.empty()) {
             break;
         }
-        chains.reset({get_current_chain()});
+        chains.reset_to_current();
         auto& chain = get_current_chain();
 
         // get candidate list
         auto& word = chain[cursor];
         if(!word.has_candidates()) {
-            auto dic  = share.primary_vocabulary;
-            auto dics = std::vector<MeCabModel*>{dic.get()};
-            for(auto& dic : share.additional_vocabularies) {
-                dics.emplace_back(dic.get());
-            }
-
-            auto  new_word = Word::from_dictionaries(dics, word);
-            auto& cands    = new_word.candidates;
-            if(cands.size() < 2) {
-                // the word does not have candidates,
-                // but we want to display candidate list anyway.
-                cands.emplace_back(cands[0]);
-            }
-
-            // insert current feature to top
-            cands.insert(cands.begin() + 2, word.feature());
-            // then hiragana
-            if(word.raw() != word.feature()) {
-                cands.insert(cands.begin() + 3, word.raw());
+            if(auto prefetched = candidate_prefetch->find(word, share.primary_vocabulary.load(), share.overlay_lexicon.load())) {
+                word = std::move(*prefetched);
+            } else {
+                word = engine.lookup_candidates(word);
             }
-            new_word.protection = ProtectionLevel::PreserveTranslation;
-            word                = std::move(new_word);
         }
         if(!word.has_candidates()) {
             goto end;
@@ -268,31 +303,29 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
             break;
         }
         if(!to_kana.empty()) {
-            pop_back_u8(to_kana);
+            utf8::pop_back(to_kana);
             apply_candidates();
             goto end;
         }
         if(chains.empty()) {
             break;
         }
-        chains.reset({get_current_chain()});
+        chains.reset_to_current();
         auto& chain = get_current_chain();
 
         auto& word = chain.back();
 
         // delete character from the word
-        const auto back = pop_back_u8(word.raw());
+        const auto back = utf8::pop_back(word.raw());
         word.protection = ProtectionLevel::None;
 
         // try to disassemble the kana character into romaji
-        auto kana8 = std::array<char, FCITX_UTF8_MAX_LENGTH>();
-        fcitx_ucs4_to_utf8(back, kana8.data());
-        if(auto romaji = kana_to_romaji(kana8.data())) {
-            to_kana = std::move(*romaji);
-            pop_back_u8(to_kana);
+        if(const auto romaji = kana_to_romaji(back)) {
+            to_kana = *romaji;
+            utf8::pop_back(to_kana);
         }
 
-        chain = engine.convert_wordchain(chain, true)[0];
+        chain = engine.convert_wordchain(chain, false, &lattice);
         if(chain.empty()) {
             chains.clear();
         } else {
@@ -314,7 +347,18 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         }
 
         if(chains.get_data_size() < 2) {
-            chains.reset(engine.convert_wordchain(get_current_chain(), false));
+            const auto page_size = size_t(share.candidate_page_size);
+            auto       page      = background_conversion && background_conversion->is_for(get_current_chain())
+                                       ? engine.finish_background_conversion(*background_conversion)
+                                       : engine.convert_wordchain_nbest(get_current_chain(), page_size);
+            background_conversion.reset();
+            if(!page.chains.empty()) {
+                auto more = WordChainCandidates::Generator();
+                if(page.rest) {
+                    more = [rest = std::move(page.rest)](const size_t count) { return rest->pull(count); };
+                }
+                chains.reset(std::move(page.chains), std::move(more));
+            }
         }
         if(!is_candidate_list_for(context, &chains)) {
             context.inputPanel().setCandidateList(std::make_unique<CandidateList>(&chains, share.candidate_page_size));
@@ -334,6 +378,32 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         goto end;
     } while(0);
 
+    // handle predict
+    do {
+        if(!share.key_config.match(Predict, event)) {
+            break;
+        }
+        if(chains.empty()) {
+            break;
+        }
+        if(!is_candidate_list_for(context, &chains)) {
+            auto predictions = engine.predict(get_current_chain(), size_t(share.candidate_page_size));
+            if(predictions.empty()) {
+                // nothing to complete, leave the key to the application
+                return;
+            }
+            chains.reset_to_current();
+            // keep the current one as the first candidate, like sentence candidates
+            predictions.insert(predictions.begin(), std::move(get_current_chain()));
+            chains.reset(std::move(predictions));
+            context.inputPanel().setCandidateList(std::make_unique<CandidateList>(&chains, share.candidate_page_size));
+        }
+        context.inputPanel().candidateList()->toCursorMovable()->nextCandidate();
+        context.updateUserInterface(fcitx::UserInterfaceComponent::InputPanel);
+        cursor = get_current_chain().size() - 1;
+        goto end;
+    } while(0);
+
     // handle commit wordchain
     do {
         if(!share.key_config.match(Commit, event)) {
@@ -363,7 +433,7 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         if(chains.empty()) {
             break;
         }
-        chains.reset({get_current_chain()});
+        chains.reset_to_current();
         const auto& chain = get_current_chain();
 
         const auto forward    = action == WordNext;
@@ -388,12 +458,12 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         if(chains.empty()) {
             break;
         }
-        chains.reset({get_current_chain()});
+        chains.reset_to_current();
         auto& chain = get_current_chain();
 
-        const auto left   = action == SplitWordLeft;
-        const auto raw_32 = u8tou32(chain[cursor].raw());
-        if(raw_32.size() == 1) {
+        const auto left = action == SplitWordLeft;
+        const auto raw  = chain[cursor].raw(); // copied, the insertion below invalidates the reference
+        if(utf8::next(raw, 0) >= raw.size()) {
             // cannot split this anymore
             goto end;
         }
@@ -405,20 +475,20 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         }
 
         // split 'a' into two
-        const auto split_pos = left ? 1 : raw_32.size() - 1;
+        const auto split_pos = left ? utf8::next(raw, 0) : utf8::prev(raw, raw.size());
 
-        a = Word::from_raw(u32tou8(raw_32.substr(0, split_pos)));
-        b = Word::from_raw(u32tou8(raw_32.substr(split_pos)));
+        a = Word::from_raw(raw.substr(0, split_pos));
+        b = Word::from_raw(raw.substr(split_pos));
 
         // protect them
         a.protection = ProtectionLevel::PreserveSeparation;
         b.protection = ProtectionLevel::PreserveSeparation;
 
         // save current cursor
-        const auto char_cursor = cursor_in_chars(chain, cursor);
+        const auto byte_cursor = cursor_in_bytes(chain, cursor);
 
-        chain  = engine.convert_wordchain(chain, true)[0];
-        cursor = cursor_in_words(chain, char_cursor);
+        chain  = engine.convert_wordchain(chain);
+        cursor = cursor_in_words(chain, byte_cursor);
         apply_candidates();
         goto end;
     } while(0);
@@ -432,7 +502,7 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         if(chains.empty()) {
             break;
         }
-        chains.reset({get_current_chain()});
+        chains.reset_to_current();
         auto& chain = get_current_chain();
 
         const auto left        = share.key_config.match(MergeWordsLeft, event);
@@ -455,11 +525,11 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         chain.erase(chain.begin() + merge_index);
 
         // save current cursor
-        const auto char_cursor = cursor_in_chars(chain, cursor);
+        const auto byte_cursor = cursor_in_bytes(chain, cursor);
 
         // translate
-        chain  = engine.convert_wordchain(chain, true)[0];
-        cursor = cursor_in_words(chain, char_cursor);
+        chain  = engine.convert_wordchain(chain);
+        cursor = cursor_in_words(chain, byte_cursor);
         apply_candidates();
         goto end;
     } while(0);
@@ -473,7 +543,7 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         if(chains.empty()) {
             break;
         }
-        chains.reset({get_current_chain()});
+        chains.reset_to_current();
         auto& chain = get_current_chain();
 
         const auto target_index = int(cursor) + (action == TakeFromLeft || action == GiveToLeft ? -1 : 1);
@@ -482,43 +552,46 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
             goto end;
         }
 
-        auto& word         = chain[cursor];
-        auto& target       = chain[target_index];
-        auto  word_feature = u8tou32(word.raw());
-        auto  tarfeature   = u8tou32(target.raw());
-        if((take && tarfeature.size() == 1) || (!take && word_feature.size() == 1)) {
+        auto& word       = chain[cursor];
+        auto& target     = chain[target_index];
+        auto& word_raw   = word.raw();
+        auto& target_raw = target.raw();
+        if(utf8::next(take ? target_raw : word_raw, 0) >= (take ? target_raw : word_raw).size()) {
+            // the source has only one character
             goto end;
         }
         switch(*action) {
-        case TakeFromLeft:
-            word_feature = tarfeature.back() + word_feature;
-            tarfeature.pop_back();
-            break;
-        case TakeFromRight:
-            word_feature = word_feature + tarfeature.front();
-            tarfeature.erase(tarfeature.begin());
-            break;
-        case GiveToLeft:
-            tarfeature = tarfeature + word_feature.front();
-            word_feature.erase(word_feature.begin());
-            break;
-        case GiveToRight:
-            tarfeature = word_feature.back() + tarfeature;
-            word_feature.pop_back();
-            break;
+        case TakeFromLeft: {
+            const auto pos = utf8::prev(target_raw, target_raw.size());
+            word_raw.insert(0, target_raw, pos);
+            target_raw.resize(pos);
+        } break;
+        case TakeFromRight: {
+            const auto pos = utf8::next(target_raw, 0);
+            word_raw.append(target_raw, 0, pos);
+            target_raw.erase(0, pos);
+        } break;
+        case GiveToLeft: {
+            const auto pos = utf8::next(word_raw, 0);
+            target_raw.append(word_raw, 0, pos);
+            word_raw.erase(0, pos);
+        } break;
+        case GiveToRight: {
+            const auto pos = utf8::prev(word_raw, word_raw.size());
+            target_raw.insert(0, word_raw, pos);
+            word_raw.resize(pos);
+        } break;
         default:
             break;
         }
-        word.raw()        = u32tou8(word_feature);
-        target.raw()      = u32tou8(tarfeature);
         word.protection   = ProtectionLevel::PreserveSeparation;
         target.protection = ProtectionLevel::PreserveSeparation;
 
         // save current cursor
-        const auto char_cursor = cursor_in_chars(chain, cursor);
+        const auto byte_cursor = cursor_in_bytes(chain, cursor);
 
-        chain  = engine.convert_wordchain(chain, true)[0];
-        cursor = cursor_in_words(chain, char_cursor);
+        chain  = engine.convert_wordchain(chain);
+        cursor = cursor_in_words(chain, byte_cursor);
         apply_candidates();
         goto end;
     } while(0);
@@ -531,22 +604,39 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
         if(chains.empty()) {
             break;
         }
-        chains.reset({get_current_chain()});
+        chains.reset_to_current();
         auto& chain = get_current_chain();
 
         auto& word = chain[cursor];
+        word.candidates.clear();
+        word.set_converted(kana::to_katakana(word.raw()));
+        word.protection = ProtectionLevel::PreserveTranslation;
 
-        auto katakana32 = std::u32string();
-        for(const auto c : u8tou32(word.raw())) {
-            if(const auto p = hiragana_katakana_table.find(c); p != hiragana_katakana_table.end()) {
-                katakana32 += p->second;
-            } else {
-                katakana32 += c;
-            }
+        apply_candidates();
+        goto end;
+    } while(0);
+
+    // handle convert the whole chain
+    do {
+        const auto action = share.key_config.match({ConvertChainHiragana, ConvertChainKatakana, ConvertChainHalfKatakana, ConvertChainFullAscii}, event);
+        if(!action) {
+            break;
+        }
+        if(chains.empty()) {
+            break;
+        }
+        chains.reset_to_current();
+        auto& chain = get_current_chain();
+
+        const auto convert = *action == ConvertChainHiragana       ? kana::to_hiragana
+                             : *action == ConvertChainKatakana     ? kana::to_katakana
+                             : *action == ConvertChainHalfKatakana ? kana::to_half_katakana
+                                                                   : +[](const std::string_view raw) { return kana::to_full_ascii(kana_to_romaji(raw)); };
+        for(auto& word : chain) {
+            word.candidates.clear();
+            word.set_converted(convert(word.raw()));
+            word.protection = ProtectionLevel::PreserveTranslation;
         }
-        word.candidates.resize(2);
-        word.candidates[1] = u32tou8(katakana32);
-        word.protection    = ProtectionLevel::PreserveTranslation;
 
         apply_candidates();
         goto end;
@@ -559,7 +649,7 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
             break;
         }
         if(!chains.empty()) {
-            chains.reset({get_current_chain()});
+            chains.reset_to_current();
             auto& chain = get_current_chain();
             cursor      = chain.size() - 1;
         }
@@ -593,7 +683,7 @@ auto Context::handle_key_event_normal(fcitx::KeyEvent& event) -> void {
             }
 
             auto& chain = get_current_chain();
-            chain       = engine.convert_wordchain(chain, true)[0];
+            chain       = engine.convert_wordchain(chain, false, &lattice);
             cursor      = chain.size() - 1;
             auto_commit();
 
@@ -631,6 +721,8 @@ end:
             context.updateUserInterface(fcitx::UserInterfaceComponent::InputPanel);
         }
     }
+    update_background_conversion();
+    update_candidate_prefetch();
 
     return;
 }
@@ -644,6 +736,8 @@ auto Context::handle_deactivate_normal() -> void {
         commit_wordchain();
         chains.clear();
     }
+    update_background_conversion();
+    update_candidate_prefetch();
     if(!to_kana.empty()) {
         context.commitString(to_kana);
         to_kana.clear();
@@ -665,5 +759,6 @@ auto Context::handle_deactivate() -> void {
 Context::Context(fcitx::InputContext& context, engine::Engine& engine, Share& share)
     : context(context),
       engine(engine),
-      share(share) {}
+      share(share),
+      candidate_prefetch(std::make_shared<engine::CandidatePrefetch>()) {}
 } // namespace mikan
@@ -1,5 +1,4 @@
 #pragma once
-#include <fcitx-utils/utf8.h>
 #include <fcitx/inputcontext.h>
 #include <fcitx/inputcontextproperty.h>
 #include <fcitx/inputpanel.h>
@@ -21,7 +20,13 @@ class Context final : public fcitx::InputContextProperty {
     size_t              cursor; // word index
     RomajiIndex         romaji_index;
     std::string         to_kana;
+    std::string         last_commit; // feature of the last committed word, the context of the next one
     WordChainCandidates chains;
+    IncrementalLattice  lattice; // keeps the last analysis for the typing path
+
+    std::shared_ptr<engine::BackgroundConversion> background_conversion;
+    std::shared_ptr<engine::CandidatePrefetch>    candidate_prefetch;
+    std::string                                   prefetch_request; // words requested to candidate_prefetch
 
     std::optional<CommandModeContext> command_mode_context;
 
@@ -33,6 +38,8 @@ class Context final : public fcitx::InputContextProperty {
     auto build_kana_text() const -> std::string;
     auto apply_candidates() -> void;
     auto auto_commit() -> void;
+    auto update_background_conversion() -> void;
+    auto update_candidate_prefetch() -> void;
     auto handle_key_event_normal(fcitx::KeyEvent& event) -> void;
     auto handle_deactivate_normal() -> void;
 
@@ -0,0 +1,90 @@
+#include "conversion-cache.hpp"
+
+namespace mikan::engine {
+namespace {
+auto estimate_bytes(const std::string& key, const WordChains& chains) -> size_t {
+    auto bytes = sizeof(std::string) + key.capacity() + chains.capacity() * sizeof(WordChain);
+    for(const auto& chain : chains) {
+        bytes += chain.capacity() * sizeof(Word);
+        for(const auto& word : chain) {
+            // converted texts are shared with the models
+            bytes += word.raw().capacity() + word.candidates.capacity() * sizeof(std::string);
+            for(const auto& str : word.candidates) {
+                bytes += str.capacity();
+            }
+        }
+    }
+    return bytes;
+}
+} // namespace
+
+auto ConversionCache::evict() -> void {
+    while(!entries.empty() && (entries.size() > max_entries || stats.bytes > max_bytes)) {
+        auto& last = entries.back();
+        index.erase(last.key);
+        stats.bytes -= last.bytes;
+        stats.evictions += 1;
+        entries.pop_back();
+    }
+    stats.entries = entries.size();
+}
+
+auto ConversionCache::set_limits(const size_t new_max_entries, const size_t new_max_bytes) -> void {
+    auto guard  = std::lock_guard(lock);
+    max_entries = new_max_entries;
+    max_bytes   = new_max_bytes;
+    evict();
+}
+
+auto ConversionCache::find(const std::string_view key) -> std::optional<WordChains> {
+    auto       guard = std::lock_guard(lock);
+    const auto p     = index.find(key);
+    if(p == index.end()) {
+        stats.misses += 1;
+        return std::nullopt;
+    }
+    stats.hits += 1;
+    entries.splice(entries.begin(), entries, p->second);
+    return p->second->chains;
+}
+
+auto ConversionCache::get_generation() const -> size_t {
+    auto guard = std::lock_guard(lock);
+    return generation;
+}
+
+auto ConversionCache::insert(std::string key, const WordChains& chains, const size_t chains_generation) -> void {
+    auto guard = std::lock_guard(lock);
+    if(max_entries == 0 || chains_generation != generation) {
+        return;
+    }
+    if(const auto p = index.find(key); p != index.end()) {
+        const auto entry = p->second;
+        stats.bytes -= entry->bytes;
+        index.erase(p);
+        entries.erase(entry);
+    }
+    const auto bytes = estimate_bytes(key, chains);
+    if(bytes > max_bytes) {
+        return;
+    }
+    auto& entry = entries.emplace_front(Entry{std::move(key), chains, bytes});
+    index.emplace(entry.key, entries.begin());
+    stats.bytes += bytes;
+    evict();
+}
+
+auto ConversionCache::clear() -> void {
+    auto guard = std::lock_guard(lock);
+    index.clear();
+    entries.clear();
+    generation += 1;
+    stats.bytes   = 0;
+    stats.entries = 0;
+}
+
+auto ConversionCache::get_stats() const -> Stats {
+    auto guard = std::lock_guard(lock);
+    return stats;
+}
+} // namespace mikan::engine
@@ -0,0 +1,53 @@
+#pragma once
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "util/string-map.hpp"
+#include "word.hpp"
+
+namespace mikan::engine {
+// lru cache of conversion results, bounded by both entry count and approximate memory usage
+// safe to be used from multiple threads
+class ConversionCache {
+  public:
+    struct Stats {
+        size_t hits      = 0;
+        size_t misses    = 0;
+        size_t evictions = 0;
+        size_t entries   = 0;
+        size_t bytes     = 0;
+    };
+
+  private:
+    struct Entry {
+        std::string key;
+        WordChains  chains;
+        size_t      bytes;
+    };
+
+    using Index = std::unordered_map<std::string_view, std::list<Entry>::iterator, internal::StringHash, std::ranges::equal_to>;
+
+    mutable std::mutex lock;
+    std::list<Entry>   entries; // most recently used first
+    Index              index;
+    size_t             max_entries = 0;
+    size_t             max_bytes   = 0;
+    size_t             generation  = 0; // bumped by clear()
+    Stats              stats;
+
+    auto evict() -> void;
+
+  public:
+    auto set_limits(size_t max_entries, size_t max_bytes) -> void;
+    auto find(std::string_view key) -> std::optional<WordChains>;
+    // take the generation before loading the models which the chains are computed with,
+    // so that a result of a model replaced meanwhile is not inserted after clear()
+    auto get_generation() const -> size_t;
+    auto insert(std::string key, const WordChains& chains, size_t generation) -> void;
+    auto clear() -> void;
+    auto get_stats() const -> Stats;
+};
+} // namespace mikan::engine
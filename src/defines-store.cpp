@@ -0,0 +1,269 @@
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "defines-store.hpp"
+#include "macros/assert.hpp"
+#include "misc.hpp"
+
+namespace mikan::engine {
+namespace {
+constexpr auto header = std::string_view("# mikan defines 2\n");
+
+struct Record {
+    char             op;
+    std::string_view payload;
+};
+
+auto format_record(const char op, const std::string_view payload) -> std::string {
+    return std::format("{} {:016x} {}\n", op, fnv1a(payload), payload);
+}
+
+// nullopt if the line is not a complete record
+auto parse_record(const std::string_view line) -> std::optional<Record> {
+    constexpr auto payload_begin = 2uz + 16 + 1;
+    if(line.size() <= payload_begin || (line[0] != '+' && line[0] != '-') || line[1] != ' ' || line[payload_begin - 1] != ' ') {
+        return std::nullopt;
+    }
+    const auto digits    = line.substr(2, 16);
+    auto       checksum  = uint64_t();
+    const auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), checksum, 16);
+    const auto payload   = line.substr(payload_begin);
+    if(ec != std::errc() || ptr != digits.data() + digits.size() || fnv1a(payload) != checksum) {
+        return std::nullopt;
+    }
+    return Record{line[0], payload};
+}
+
+// "raw,converted" -> (raw, converted)
+auto split_definition(const std::string_view payload) -> std::optional<std::pair<std::string_view, std::string_view>> {
+    const auto comma = payload.find(',');
+    if(comma == payload.npos) {
+        return std::nullopt;
+    }
+    const auto raw       = payload.substr(0, comma);
+    const auto converted = payload.substr(comma + 1);
+    if(raw.empty() || converted.empty() || converted.find(',') != converted.npos) {
+        return std::nullopt;
+    }
+    return std::pair(raw, converted);
+}
+
+auto write_all(const int fd, const std::string_view data) -> bool {
+    for(auto done = 0uz; done < data.size();) {
+        const auto ret = write(fd, data.data() + done, data.size() - done);
+        if(ret < 0 && errno == EINTR) {
+            continue;
+        }
+        ensure(ret > 0, "write failed: {}", strerror(errno));
+        done += ret;
+    }
+    return true;
+}
+
+auto fsync_directory(const std::string& path) -> void {
+    const auto fd = ::open(std::filesystem::path(path).parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+} // namespace
+
+auto DefinesStore::append(const char op, const std::string_view payload) -> bool {
+    ensure(fd >= 0, "store not opened");
+    const auto size = lseek(fd, 0, SEEK_END);
+    ensure(size >= 0, "lseek failed: {}", strerror(errno));
+    // the record is durable before the caller acts on it
+    if(!write_all(fd, format_record(op, payload)) || fdatasync(fd) != 0) {
+        // cut off a partially written record, so that the next one does not continue it
+        if(ftruncate(fd, size) != 0) {
+            WARN("failed to truncate {}: {}", path, strerror(errno));
+        }
+        bail("failed to append to {}", path);
+    }
+    log_count += 1;
+    return true;
+}
+
+auto DefinesStore::replay(const std::string_view contents) -> size_t {
+    auto pos = header.size();
+    while(true) {
+        const auto end = contents.find('\n', pos);
+        if(end == contents.npos) {
+            // unterminated, torn by a crash
+            break;
+        }
+        const auto line = contents.substr(pos, end - pos);
+        pos             = end + 1;
+
+        if(line.empty()) {
+            continue;
+        }
+        if(!line.starts_with("+ ") && !line.starts_with("- ")) {
+            // "raw,converted" added by hand
+            const auto definition = split_definition(line);
+            if(!definition) {
+                WARN(R"(failed to parse line "{}" of file {})", line, path);
+                continue;
+            }
+            log_count += 1;
+            if(emplace_unique(definitions[std::string(definition->first)], std::string(definition->second))) {
+                live_count += 1;
+            }
+            continue;
+        }
+        const auto record = parse_record(line);
+        if(!record) {
+            WARN(R"(skipping broken record "{}" of file {})", line, path);
+            continue;
+        }
+        log_count += 1;
+        if(record->op == '-') {
+            if(const auto p = definitions.find(std::string(record->payload)); p != definitions.end()) {
+                live_count -= p->second.size();
+                definitions.erase(p);
+            }
+            continue;
+        }
+        const auto definition = split_definition(record->payload);
+        if(!definition) {
+            WARN(R"(skipping invalid definition "{}" of file {})", record->payload, path);
+            continue;
+        }
+        if(emplace_unique(definitions[std::string(definition->first)], std::string(definition->second))) {
+            live_count += 1;
+        }
+    }
+    return pos;
+}
+
+auto DefinesStore::replay_legacy(const std::string_view contents) -> void {
+    for(auto pos = 0uz; pos < contents.size();) {
+        const auto end  = std::min(contents.find('\n', pos), contents.size());
+        const auto line = contents.substr(pos, end - pos);
+        pos             = end + 1;
+        if(line.empty()) {
+            continue;
+        }
+        const auto definition = split_definition(line);
+        if(!definition) {
+            WARN(R"(failed to parse line "{}" of file {})", line, path);
+            continue;
+        }
+        if(emplace_unique(definitions[std::string(definition->first)], std::string(definition->second))) {
+            live_count += 1;
+        }
+    }
+}
+
+auto DefinesStore::rewrite() -> bool {
+    auto contents = std::string(header);
+    for(const auto& [raw, list] : definitions) {
+        for(const auto& converted : list) {
+            contents += format_record('+', std::format("{},{}", raw, converted));
+        }
+    }
+
+    // write a new log aside, then replace the old one atomically
+    const auto tmp_path = path + ".tmp";
+    const auto tmp_fd   = ::open(tmp_path.data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ensure(tmp_fd >= 0, "failed to open {}: {}", tmp_path, strerror(errno));
+    const auto written = write_all(tmp_fd, contents) && fsync(tmp_fd) == 0;
+    close(tmp_fd);
+    ensure(written, "failed to write {}", tmp_path);
+    ensure(rename(tmp_path.data(), path.data()) == 0, "failed to rename {}: {}", tmp_path, strerror(errno));
+    fsync_directory(path);
+
+    if(fd >= 0) {
+        close(fd);
+    }
+    fd = ::open(path.data(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    ensure(fd >= 0, "failed to open {}: {}", path, strerror(errno));
+    log_count = live_count;
+    return true;
+}
+
+auto DefinesStore::open(std::string new_path) -> bool {
+    auto guard = std::lock_guard(lock);
+    path       = std::move(new_path);
+    definitions.clear();
+    live_count = 0;
+    log_count  = 0;
+    if(fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    auto contents = std::string();
+    if(auto source = std::ifstream(path, std::ios::binary)) {
+        contents.assign(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>());
+    }
+    if(!contents.starts_with(header)) {
+        // a new file, or one from older versions
+        replay_legacy(contents);
+        return rewrite();
+    }
+
+    const auto valid = replay(contents);
+    fd               = ::open(path.data(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    ensure(fd >= 0, "failed to open {}: {}", path, strerror(errno));
+    if(valid < contents.size()) {
+        WARN("discarding an unterminated record at the end of {}", path);
+        ensure(ftruncate(fd, off_t(valid)) == 0, "failed to truncate {}: {}", path, strerror(errno));
+    }
+    return true;
+}
+
+auto DefinesStore::add(const std::string_view raw, const std::string_view converted) -> bool {
+    auto guard = std::lock_guard(lock);
+    if(const auto p = definitions.find(std::string(raw)); p != definitions.end() && contains(p->second, converted)) {
+        return true;
+    }
+    ensure(append('+', std::format("{},{}", raw, converted)));
+    definitions[std::string(raw)].emplace_back(converted);
+    live_count += 1;
+    return true;
+}
+
+auto DefinesStore::remove(const std::string_view raw) -> bool {
+    auto guard = std::lock_guard(lock);
+    const auto p = definitions.find(std::string(raw));
+    ensure(p != definitions.end(), "no definitions matched");
+    ensure(append('-', raw));
+    live_count -= p->second.size();
+    definitions.erase(p);
+    return true;
+}
+
+auto DefinesStore::get_definitions() const -> Definitions {
+    auto guard = std::lock_guard(lock);
+    return definitions;
+}
+
+auto DefinesStore::needs_compaction() const -> bool {
+    constexpr auto min_garbage = 64uz;
+
+    auto guard = std::lock_guard(lock);
+    return log_count > live_count * 2 + min_garbage;
+}
+
+auto DefinesStore::compact() -> bool {
+    auto guard = std::lock_guard(lock);
+    ensure(fd >= 0, "store not opened");
+    return rewrite();
+}
+
+DefinesStore::~DefinesStore() {
+    if(fd >= 0) {
+        close(fd);
+    }
+}
+} // namespace mikan::engine
@@ -0,0 +1,47 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mikan::engine {
+// user definitions added by /def, kept as an append-only log.
+// the first line is a header, followed by one record per line:
+//   "+ <checksum> raw,converted": a definition
+//   "- <checksum> raw":           a tombstone, removes every definition of raw before it
+// the checksum is the fnv-1a hash of the rest of the line in hex, so that torn or corrupt records are skipped.
+// other lines are "raw,converted" definitions without a checksum, so that the file can be edited by hand.
+// an unterminated last record is discarded, and cut off before the next append.
+// files without the header are from older versions, with one "raw,converted" per line, and are converted on open.
+// the log is compacted once it grows much larger than the live definitions.
+// safe to be used from multiple threads
+class DefinesStore {
+  public:
+    using Definitions = std::map<std::string, std::vector<std::string>>; // raw -> converted
+
+  private:
+    mutable std::mutex lock;
+    std::string        path;
+    int                fd = -1; // opened for appending
+    Definitions        definitions;
+    size_t             live_count = 0; // number of definitions
+    size_t             log_count  = 0; // number of records in the log
+
+    auto append(char op, std::string_view payload) -> bool;
+    auto replay(std::string_view contents) -> size_t;
+    auto replay_legacy(std::string_view contents) -> void;
+    auto rewrite() -> bool;
+
+  public:
+    auto open(std::string path) -> bool;
+    auto add(std::string_view raw, std::string_view converted) -> bool;
+    // false if nothing matched
+    auto remove(std::string_view raw) -> bool;
+    auto get_definitions() const -> Definitions;
+    auto needs_compaction() const -> bool;
+    // rewrites the log with the live definitions only
+    auto compact() -> bool;
+
+    ~DefinesStore();
+};
+} // namespace mikan::engine
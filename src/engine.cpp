@@ -1,14 +1,24 @@
 #include <array>
+#include <charconv>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
-#include <unordered_set>
+#include <future>
+#include <unordered_map>
+#include <utility>
+
+#include <fcntl.h>
+#include <fcitx-utils/log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "engine.hpp"
 #include "macros/unwrap.hpp"
 #include "misc.hpp"
+#include "utf8.hpp"
 #include "util/charconv.hpp"
 #include "util/split.hpp"
-#include "util/string-map.hpp"
 
 namespace {
 auto split_strip(const std::string_view str, const std::string_view dlm = " ") -> std::vector<std::string_view> {
@@ -16,12 +26,31 @@ auto split_strip(const std::string_view str, const std::string_view dlm = " ") -
     std::erase(vec, "");
     return vec;
 }
-
-using StringSet = std::unordered_set<std::string, internal::StringHash, std::ranges::equal_to>;
 } // namespace
 
 namespace mikan::engine {
 namespace {
+// definitions added in a row are compiled at once
+constexpr auto overlay_compaction_delay = std::chrono::seconds(3);
+// selections made in a row refresh the prediction index at once
+constexpr auto prediction_refresh_delay = std::chrono::seconds(1);
+
+// logs the time spent in each phase of a sequence
+class PhaseTimer {
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point start = Clock::now();
+
+  public:
+    auto lap(const std::string_view phase) -> void {
+        const auto now     = Clock::now();
+        const auto elapsed = std::chrono::duration<double, std::milli>(now - start);
+        FCITX_INFO() << std::format("{}: {:.1f}ms", phase, elapsed.count());
+        start = now;
+    }
+};
+
 auto build_raw_and_constraints(const WordChain& chain, const bool ignore_protection) -> std::pair<std::string, std::vector<FeatureConstriant>> {
     auto feature_constriants = std::vector<FeatureConstriant>();
     auto buffer              = std::string();
@@ -37,20 +66,241 @@ auto build_raw_and_constraints(const WordChain& chain, const bool ignore_protect
     return std::make_pair(buffer, feature_constriants);
 }
 
-auto load_text_dictionary(const char* const path, std::vector<ConvDef>& defs) -> bool {
-    ensure(std::filesystem::is_regular_file(path), "not a file {}", path);
-    auto source = std::fstream(path);
-    auto line   = std::string();
-    while(std::getline(source, line)) {
-        const auto elms = split_strip(line, ",");
-        auto       def  = ConvDef();
-        if(elms.size() != 2) {
-            WARN(R"(failed to parse line "{}" of file {})", line, path);
+// read-only mapping of a whole file
+struct MappedFile {
+    void*  data = MAP_FAILED;
+    size_t size = 0;
+
+    auto as_view() const -> std::string_view {
+        return size == 0 ? std::string_view() : std::string_view(static_cast<const char*>(data), size);
+    }
+
+    MappedFile(const char* const path) {
+        const auto fd = open(path, O_RDONLY | O_CLOEXEC);
+        if(fd < 0) {
+            return;
+        }
+        struct stat st = {};
+        if(fstat(fd, &st) == 0 && st.st_size > 0) {
+            size = st.st_size;
+            data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(data != MAP_FAILED) {
+                madvise(data, size, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+    }
+
+    MappedFile(MappedFile&& o) : data(std::exchange(o.data, MAP_FAILED)), size(std::exchange(o.size, 0)) {}
+
+    ~MappedFile() {
+        if(data != MAP_FAILED) {
+            munmap(data, size);
+        }
+    }
+};
+
+// "raw,converted" per line. empty fields are skipped, like the other lines of the file.
+// the definitions point into text.
+auto parse_text_dictionary(const std::string_view text, const char* const path, const std::function<void(ConvDef)>& callback) -> void {
+    auto pos = 0uz;
+    while(pos < text.size()) {
+        auto end = text.find('\n', pos);
+        if(end == text.npos) {
+            end = text.size();
+        }
+        const auto line = text.substr(pos, end - pos);
+        pos             = end + 1;
+
+        auto fields = std::array<std::string_view, 2>();
+        auto count  = 0uz;
+        for(auto field_pos = 0uz; field_pos <= line.size() && count <= fields.size();) {
+            auto field_end = line.find(',', field_pos);
+            if(field_end == line.npos) {
+                field_end = line.size();
+            }
+            if(field_end != field_pos) {
+                if(count < fields.size()) {
+                    fields[count] = line.substr(field_pos, field_end - field_pos);
+                }
+                count += 1;
+            }
+            field_pos = field_end + 1;
+        }
+        if(count != fields.size()) {
+            if(!line.empty()) {
+                WARN(R"(failed to parse line "{}" of file {})", line, path);
+            }
             continue;
         }
-        defs.emplace_back(ConvDef{std::string(elms[0]), std::string(elms[1])});
+        callback(ConvDef{fields[0], fields[1]});
     }
-    return true;
+}
+
+auto is_compilable(const std::string_view str) -> bool {
+    return !str.empty() && str.find_first_of(std::string_view("\"\n\r\0", 4)) == str.npos && utf8::validate(str);
+}
+
+// anonymous file on memory, accessible with a path while opened
+struct MemoryFile {
+    int fd;
+
+    auto get_path() const -> std::string {
+        return std::format("/proc/self/fd/{}", fd);
+    }
+
+    MemoryFile(const char* const name) : fd(memfd_create(name, MFD_CLOEXEC)) {}
+
+    ~MemoryFile() {
+        if(fd >= 0) {
+            close(fd);
+        }
+    }
+};
+
+// runs mecab-dict-index in this process.
+// it exits the process on malformed input, so the input is validated by merge_dictionaries() and compile_user_dictionary_cached() beforehand.
+// it is not reentrant either, callers hold Engine::compile_lock.
+auto compile_user_dictionary(std::vector<std::string> args) -> int {
+    auto argv = std::vector<char*>();
+    for(auto& arg : args) {
+        argv.emplace_back(arg.data());
+    }
+    argv.emplace_back(nullptr);
+    return mecab_dict_index(int(args.size()), argv.data());
+}
+
+constexpr auto compiled_dictionary_prefix = "user-dictionary-";
+
+// identifies a compiled user dictionary.
+// the binary depends on the system dictionary and the compiler as well as the sources.
+auto hash_dictionary_inputs(const std::string_view csv, const std::string& system_dictionary_path) -> uint64_t {
+    auto hash = fnv1a(csv);
+    hash      = fnv1a(mecab_version(), hash);
+    hash      = fnv1a(system_dictionary_path, hash);
+    for(const auto name : {"dicrc", "sys.dic", "matrix.bin", "char.bin", "unk.dic"}) {
+        const auto path  = system_dictionary_path + "/" + name;
+        auto       error = std::error_code();
+        const auto size  = std::filesystem::file_size(path, error);
+        const auto time  = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        hash             = fnv1a(std::format("{}:{}:{}", name, size, time), hash);
+    }
+    return hash;
+}
+
+auto remove_stale_dictionaries(const std::string& cache_dir, const std::string& current) -> void {
+    auto error = std::error_code();
+    for(const auto& entry : std::filesystem::directory_iterator(cache_dir, error)) {
+        const auto name = entry.path().filename().string();
+        if(name.starts_with(compiled_dictionary_prefix) && name.ends_with(".bin") && entry.path() != current) {
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+}
+
+// checks the header of a compiled user dictionary like mecab does on loading,
+// which fails the assertion in MeCabModel instead of returning an error
+auto is_valid_user_dictionary(const std::string& path) -> bool {
+    // magic, version, type, and the sizes of the sections, followed by the charset
+    constexpr auto magic_id        = uint32_t(0xef718f77);
+    constexpr auto version         = uint32_t(102);
+    constexpr auto user_dictionary = uint32_t(1);
+
+    auto       error = std::error_code();
+    const auto size  = std::filesystem::file_size(path, error);
+    if(error || size < sizeof(uint32_t) * 10 + 32) {
+        return false;
+    }
+    auto header = std::array<uint32_t, 3>();
+    auto file   = std::ifstream(path, std::ios::binary);
+    if(!file.read(reinterpret_cast<char*>(header.data()), sizeof(header))) {
+        return false;
+    }
+    return (header[0] ^ magic_id) == size && header[1] == version && header[2] == user_dictionary;
+}
+
+// flushes a file or a directory to the disk
+auto sync_path(const std::string& path, const int flags) -> bool {
+    const auto fd = open(path.data(), O_RDONLY | O_CLOEXEC | flags);
+    if(fd < 0) {
+        return false;
+    }
+    const auto result = fsync(fd) == 0;
+    close(fd);
+    return result;
+}
+
+// returns the path to the compiled dictionary
+auto compile_user_dictionary_cached(const std::string& csv, const std::string& system_dictionary_path) -> std::optional<std::string> {
+    // mecab_dict_index() aborts the process instead of returning an error on missing files
+    ensure(std::filesystem::is_regular_file(system_dictionary_path + "/dicrc"), "invalid system dictionary {}", system_dictionary_path);
+
+    const auto cache_dir = get_user_cache_dir();
+    ensure(std::filesystem::is_directory(cache_dir) || std::filesystem::create_directories(cache_dir));
+    const auto bin_path = std::format("{}/{}{:016x}.bin", cache_dir, compiled_dictionary_prefix, hash_dictionary_inputs(csv, system_dictionary_path));
+    if(std::filesystem::is_regular_file(bin_path)) {
+        if(is_valid_user_dictionary(bin_path)) {
+            return bin_path;
+        }
+        WARN("removing broken compiled dictionary {}", bin_path);
+        auto error = std::error_code();
+        std::filesystem::remove(bin_path, error);
+    }
+
+    const auto csv_file = MemoryFile("mikan-dict.csv");
+    ensure(csv_file.fd >= 0, "failed to create memory file");
+    const auto csv_path = csv_file.get_path();
+    {
+        auto file = std::ofstream(csv_path);
+        file << csv;
+        ensure(file.flush(), "failed to write dictionary source");
+    }
+
+    // compile to a temporary file so that a broken binary is never picked up
+    const auto tmp_path = std::format("{}.{}.tmp", bin_path, getpid());
+    const auto code     = compile_user_dictionary({"mecab-dict-index", "-d", system_dictionary_path, "-u", tmp_path, "-f", "utf-8", "-t", "utf-8", csv_path});
+    auto       error    = std::error_code();
+    if(code != 0) {
+        std::filesystem::remove(tmp_path, error);
+        bail("failed to compile user dictionary");
+    }
+    // the data and the rename must both reach the disk, or a crash can leave an empty file under the final name
+    if(!sync_path(tmp_path, 0)) {
+        std::filesystem::remove(tmp_path, error);
+        bail("failed to sync compiled dictionary");
+    }
+    std::filesystem::rename(tmp_path, bin_path, error);
+    ensure(!error, "failed to save compiled dictionary {}", error.message());
+    if(!sync_path(cache_dir, O_DIRECTORY)) {
+        WARN("failed to sync {}", cache_dir);
+    }
+    remove_stale_dictionaries(cache_dir, bin_path);
+    return bin_path;
+}
+
+// results with the overlay lexicon and without it differ, until it is compiled into the user dictionary.
+// built on every key press, so in a single allocation in the common case
+auto build_cache_key(const std::string& raw, const std::vector<FeatureConstriant>& constraints, const size_t paths, const bool overlay) -> std::string {
+    auto       key    = std::string();
+    const auto append = [&key](const size_t number) {
+        auto buffer = std::array<char, 20>();
+        key.append(buffer.data(), std::to_chars(buffer.data(), buffer.data() + buffer.size(), number).ptr);
+    };
+    key.reserve(raw.size() + 8 + constraints.size() * 16);
+    append(paths);
+    key += overlay ? ",1\n" : ",0\n";
+    key += raw;
+    for(const auto& c : constraints) {
+        const auto& word    = *c.word;
+        const auto  feature = word.protection == ProtectionLevel::PreserveTranslation ? word.feature() : "*";
+        key += '\n';
+        append(c.begin);
+        key += ',';
+        append(c.end);
+        key += ',';
+        key += feature;
+    }
+    return key;
 }
 
 auto set_constraints(MeCab::Lattice& lattice, const std::vector<FeatureConstriant>& constraints) -> void {
@@ -61,22 +311,187 @@ auto set_constraints(MeCab::Lattice& lattice, const std::vector<FeatureConstrian
     }
 }
 
-auto parse_nodes(MeCab::Lattice& lattice, const bool needs_parsed_feature) -> std::pair<std::string, WordChain> {
-    auto parsed         = WordChain();
-    auto parsed_feature = std::string();
+// words referencing the features in the model, except the constrained ones,
+// whose features can be owned by the lattice and are copied
+auto word_from_node(const std::string_view surface, const char* const feature, const bool unknown, const size_t begin, const std::vector<FeatureConstriant>& constraints, const std::shared_ptr<MeCabModel>& model) -> Word {
+    const auto end         = begin + surface.size();
+    const auto constrained = std::ranges::any_of(constraints, [&](const FeatureConstriant& c) { return c.begin < end && begin < c.end; });
+    if(!constrained) {
+        return Word::from_node(surface, feature, unknown, model);
+    }
+    auto word = Word::from_raw(std::string(surface));
+    if(!unknown) {
+        word.set_converted(feature);
+    }
+    return word;
+}
+
+auto parse_sentence(const std::shared_ptr<MeCabModel>& dic, const std::string& raw, const std::vector<FeatureConstriant>& constraints) -> WordChain {
+    auto  result      = WordChain();
+    auto  lattice_ref = dic->acquire_lattice();
+    auto& lattice     = *lattice_ref;
+    lattice.set_request_type(MECAB_ONE_BEST);
+    lattice.set_sentence(raw.data());
+    set_constraints(lattice, constraints);
+    dic->tagger->parse(&lattice);
     for(const auto* node = lattice.bos_node(); node; node = node->next) {
         if(node->stat == MECAB_BOS_NODE || node->stat == MECAB_EOS_NODE) {
             continue;
         }
-        parsed.emplace_back(Word::from_node(*node));
-        if(needs_parsed_feature) {
-            parsed_feature += node->feature;
+        const auto begin = size_t(node->surface - lattice.sentence());
+        result.emplace_back(word_from_node(std::string_view(node->surface, node->length), node->feature, node->stat == MECAB_UNK_NODE, begin, constraints, dic));
+    }
+    return result;
+}
+
+auto is_same_chain(const WordChain& a, const WordChain& b) -> bool {
+    return std::ranges::equal(a, b, [](const Word& a, const Word& b) { return a.raw() == b.raw() && a.feature() == b.feature(); });
+}
+
+auto retrieve_protection(WordChain& chain, const std::vector<FeatureConstriant>& constraints) -> void {
+    const auto offsets = ChainOffsets::from_chain(chain);
+    for(const auto& constraint : constraints) {
+        // this is a word from a protected one
+        const auto i = offsets.word_at(constraint.begin);
+        if(i >= chain.size() || offsets.begins[i] != constraint.begin) {
+            PANIC("protected word lost");
+        }
+        auto& word      = chain[i];
+        word.protection = constraint.word->protection;
+        if(word.protection == ProtectionLevel::PreserveTranslation) {
+            word = *constraint.word;
         }
     }
-    return std::make_pair(parsed_feature, parsed);
 }
 } // namespace
 
+auto NbestConversion::generate(const size_t count) -> WordChains {
+    // fnv-1a over the (surface length, feature) sequence of a path
+    const auto fingerprint = [](const std::span<const NodeView> nodes) -> uint64_t {
+        auto hash = fnv1a({});
+        for(const auto& node : nodes) {
+            const auto length = node.surface.size();
+            hash              = fnv1a(std::string_view(reinterpret_cast<const char*>(&length), sizeof(length)), hash);
+            // with the terminator, so that the boundary to the next node is unambiguous
+            hash = fnv1a(std::string_view(node.feature, std::strlen(node.feature) + 1), hash);
+        }
+        return hash;
+    };
+    const auto is_same_path = [](const std::span<const NodeView> a, const std::span<const NodeView> b) -> bool {
+        return std::ranges::equal(a, b, [](const NodeView& a, const NodeView& b) {
+            return a.surface.size() == b.surface.size() && (a.feature == b.feature || std::strcmp(a.feature, b.feature) == 0);
+        });
+    };
+
+    auto result = WordChains();
+    while(result.size() < count && !exhausted) {
+        if(!lattice) {
+            lattice = model->acquire_lattice();
+            lattice->set_request_type(MECAB_NBEST);
+            lattice->set_sentence(raw.data());
+            set_constraints(*lattice, constraints);
+            if(!model->tagger->parse(lattice.get())) {
+                exhausted = true;
+                break;
+            }
+        } else if(!lattice->next()) {
+            exhausted = true;
+            break;
+        }
+
+        nodes.clear();
+        for(const auto* node = lattice->bos_node(); node; node = node->next) {
+            if(node->stat == MECAB_BOS_NODE || node->stat == MECAB_EOS_NODE) {
+                continue;
+            }
+            nodes.emplace_back(NodeView{std::string_view(node->surface, node->length), node->feature, node->stat == MECAB_UNK_NODE});
+        }
+        const auto hash  = fingerprint(nodes);
+        const auto range = found.equal_range(hash);
+        const auto dup   = std::any_of(range.first, range.second, [&](const auto& e) {
+            return is_same_path(nodes, std::span(accepted).subspan(e.second.first, e.second.second));
+        });
+        if(dup) {
+            continue;
+        }
+        found.emplace(hash, std::pair(accepted.size(), nodes.size()));
+        accepted.insert(accepted.end(), nodes.begin(), nodes.end());
+        generated += 1;
+
+        if(generated > skip) {
+            // materialize words only for new paths
+            auto& chain = result.emplace_back();
+            chain.reserve(nodes.size());
+            for(const auto& node : nodes) {
+                const auto begin = size_t(node.surface.data() - lattice->sentence());
+                chain.emplace_back(word_from_node(node.surface, node.feature, node.unknown, begin, constraints, model));
+            }
+        }
+        if(generated >= limit) {
+            exhausted = true;
+        }
+    }
+    if(exhausted) {
+        lattice.reset();
+    }
+    return result;
+}
+
+auto NbestConversion::pull(const size_t count) -> WordChains {
+    auto result = WordChains();
+    while(result.size() < count && !exhausted) {
+        for(auto& chain : generate(count - result.size())) {
+            retrieve_protection(chain, constraints);
+            // delivered with the first page already
+            if(!is_same_chain(chain, best)) {
+                result.emplace_back(std::move(chain));
+            }
+        }
+    }
+    return result;
+}
+
+NbestConversion::NbestConversion(std::shared_ptr<MeCabModel> model, const WordChain& source, const size_t skip, const size_t limit)
+    : model(std::move(model)),
+      source(source),
+      skip(skip),
+      limit(limit) {
+    std::tie(raw, constraints) = build_raw_and_constraints(this->source, false);
+}
+
+auto BackgroundConversion::cancel() -> void {
+    auto guard = std::lock_guard(lock);
+    cancelled  = true;
+}
+
+auto BackgroundConversion::is_for(const WordChain& chain) const -> bool {
+    return std::ranges::equal(source, chain, [](const Word& a, const Word& b) {
+        return a.protection == b.protection && a.raw() == b.raw() && a.feature() == b.feature();
+    });
+}
+
+auto CandidatePrefetch::key_of(const Word& word) -> std::string {
+    return std::format("{}\n{}", word.raw(), word.feature());
+}
+
+auto CandidatePrefetch::find(const Word& word, const std::shared_ptr<MeCabModel>& current_model, const std::shared_ptr<const OverlayLexicon>& current_overlay) -> std::optional<Word> {
+    auto guard = std::lock_guard(lock);
+    if(model != current_model || overlay != current_overlay) {
+        // dictionary reloaded or words defined
+        return std::nullopt;
+    }
+    const auto p = words.find(key_of(word));
+    if(p == words.end()) {
+        return std::nullopt;
+    }
+    return p->second;
+}
+
+auto CandidatePrefetch::cancel() -> void {
+    auto guard = std::lock_guard(lock);
+    generation += 1;
+}
+
 auto Engine::parse_configuration_line(const std::string_view line) -> bool {
     if(line.empty() || line[0] == '#') {
         return true;
@@ -93,6 +508,38 @@ auto Engine::parse_configuration_line(const std::string_view line) -> bool {
     } else if(key == "auto_commit_threshold") {
         unwrap(num, from_chars<int>(value));
         share.auto_commit_threshold = num;
+    } else if(key == "n_best_limit") {
+        unwrap(num, from_chars<size_t>(value));
+        share.n_best_limit = num;
+    } else if(key == "conversion_cache_size") {
+        unwrap(num, from_chars<size_t>(value));
+        share.conversion_cache_size = num;
+    } else if(key == "conversion_cache_memory") {
+        unwrap(num, from_chars<size_t>(value));
+        share.conversion_cache_memory = num * 1024;
+    } else if(key == "background_delay") {
+        unwrap(num, from_chars<size_t>(value));
+        share.background_delay = num;
+    } else if(key == "prefetch_budget") {
+        unwrap(num, from_chars<size_t>(value));
+        share.prefetch_budget = num;
+    } else if(key == "prefetch_neighbours") {
+        unwrap(num, from_chars<size_t>(value));
+        share.prefetch_neighbours = num;
+    } else if(key == "vocabulary_warmup") {
+        if(value == "on") {
+            share.vocabulary_warmup = true;
+        } else if(value == "off") {
+            share.vocabulary_warmup = false;
+        } else {
+            bail("invalid vocabulary_warmup value {}", value);
+        }
+    } else if(key == "vocabulary_idle_timeout") {
+        unwrap(num, from_chars<size_t>(value));
+        share.vocabulary_idle_timeout = num;
+    } else if(key == "history_size") {
+        unwrap(num, from_chars<size_t>(value));
+        share.history_size = num;
     } else if(key == "dictionary") {
         emplace_unique(user_dictionary_paths, get_user_config_dir() + "/" + std::string(value));
     } else if(key == "insert_space") {
@@ -126,198 +573,601 @@ auto Engine::load_configuration() -> bool {
     return true;
 }
 
-auto Engine::merge_dictionaries(const char* const path) const -> bool {
+auto Engine::merge_dictionaries() const -> std::string {
+    struct ConvDefHash {
+        auto operator()(const ConvDef& def) const -> size_t {
+            return fnv1a(def.converted, fnv1a(",", fnv1a(def.raw)));
+        }
+    };
+    struct ConvDefEqual {
+        auto operator()(const ConvDef& a, const ConvDef& b) const -> bool {
+            return a.raw == b.raw && a.converted == b.converted;
+        }
+    };
+
+    // definitions point into these
+    const auto definitions = defines.get_definitions();
+    auto       files       = std::vector<MappedFile>();
+    files.reserve(user_dictionary_paths.size());
+
+    // duplicated definitions are merged into the last one, so that later sources take precedence in the order
     auto to_compile = std::vector<ConvDef>();
+    auto indices    = std::unordered_map<ConvDef, size_t, ConvDefHash, ConvDefEqual>();
+    auto add        = [&to_compile, &indices](const ConvDef def) {
+        const auto [it, inserted] = indices.try_emplace(def, to_compile.size());
+        if(!inserted) {
+            to_compile[it->second] = ConvDef();
+            it->second             = to_compile.size();
+        }
+        to_compile.push_back(def);
+    };
 
-    const auto defines_path = get_user_cache_dir() + "/defines.txt";
-    if(std::filesystem::is_regular_file(defines_path)) {
-        load_text_dictionary(defines_path.data(), to_compile);
+    for(const auto& [raw, converted] : definitions) {
+        for(const auto& word : converted) {
+            add(ConvDef{raw, word});
+        }
     }
-
     for(const auto& dict : user_dictionary_paths) {
-        load_text_dictionary(dict.data(), to_compile);
+        if(!std::filesystem::is_regular_file(dict)) {
+            WARN("not a file {}", dict);
+            continue;
+        }
+        const auto& file = files.emplace_back(dict.data());
+        if(file.size != 0 && file.data == MAP_FAILED) {
+            WARN("failed to map {}", dict);
+            continue;
+        }
+        parse_text_dictionary(file.as_view(), dict.data(), add);
     }
 
-    {
-        auto file = std::ofstream(path);
-        for(const auto& def : to_compile) {
-            std::println(file, "{},0,0,0,{}", def.raw, def.converted);
+    auto csv = std::string();
+    csv.reserve(indices.size() * 32);
+    for(const auto& def : to_compile) {
+        if(def.raw.empty()) {
+            continue; // overridden by a later duplicate
         }
+        // the compiler terminates the process on malformed input, so filter them here
+        if(!is_compilable(def.raw) || !is_compilable(def.converted)) {
+            WARN(R"(ignoring invalid definition "{},{}")", def.raw, def.converted);
+            continue;
+        }
+        csv += def.raw;
+        csv += ",0,0,0,";
+        csv += def.converted;
+        csv += '\n';
     }
-    return true;
+    return csv;
 }
 
-auto Engine::compile_and_reload_user_dictionary() -> bool {
-    const auto tmpdir = std::format("/tmp/mikan-{}", getpid());
-    std::filesystem::create_directories(tmpdir);
+auto Engine::update_overlay_lexicon(const std::function<OverlayLexicon(const OverlayLexicon&)>& modify) -> void {
+    auto current = share.overlay_lexicon.load();
+    while(!share.overlay_lexicon.compare_exchange_weak(current, std::make_shared<const OverlayLexicon>(modify(*current)))) {
+    }
+    conversion_cache.clear();
+}
 
-    const auto csv_path = tmpdir + "/dict.csv";
-    const auto bin_path = tmpdir + "/dict.bin";
-    merge_dictionaries(csv_path.data());
+auto Engine::apply_history(Word& word, const std::string_view context) const -> void {
+    if(word.protection != ProtectionLevel::None) {
+        return;
+    }
+    if(auto preferred = history.find_preferred(context, word.raw(), word.feature())) {
+        word.set_converted(std::move(*preferred));
+    }
+}
 
-    auto command = std::string();
-    command += dictionary_compiler_path;
-    command += " -d ";
-    command += system_dictionary_path;
-    command += " -u ";
-    command += bin_path;
-    command += " -f utf-8 -t utf-8 ";
-    command += csv_path;
-    command += " >& /dev/null";
-    const auto code = system(command.data());
+auto Engine::apply_history(WordChain& chain) const -> void {
+    auto context = std::string_view();
+    for(auto& word : chain) {
+        apply_history(word, context);
+        context = word.feature();
+    }
+}
 
-    reload_dictionary(bin_path.data());
+auto Engine::predict(const WordChain& chain, const size_t count) const -> WordChains {
+    auto prefix  = std::string();
+    auto current = std::string();
+    for(const auto& word : chain) {
+        prefix += word.raw();
+        current += word.feature();
+    }
+    const auto index = prediction_index.load();
+    const auto delta = prediction_delta.load();
+    if(prefix.empty() || !index || !delta) {
+        return {};
+    }
 
-    std::filesystem::remove_all(tmpdir);
+    // the delta comes first among equals, and each of its results can hide a duplicate from the dictionaries
+    const auto from_delta = delta->search(prefix, count);
+    const auto from_index = index->search(prefix, count + from_delta.size());
+    const auto is_better  = [](const PredictionIndex::Prediction& a, const PredictionIndex::Prediction& b) {
+        return a.weight != b.weight ? a.weight > b.weight : a.raw.size() < b.raw.size();
+    };
+    auto merged = std::vector<PredictionIndex::Prediction>();
+    std::ranges::merge(from_delta, from_index, std::back_inserter(merged), is_better);
+    auto predictions = std::vector<PredictionIndex::Prediction>();
+    for(const auto& prediction : merged) {
+        const auto same = [&prediction](const PredictionIndex::Prediction& o) { return o.raw == prediction.raw && o.converted == prediction.converted; };
+        if(predictions.size() < count && !std::ranges::any_of(predictions, same)) {
+            predictions.emplace_back(prediction);
+        }
+    }
 
-    ensure(code == 0);
+    auto chains = WordChains();
+    for(const auto& prediction : predictions) {
+        if(prediction.raw == prefix && prediction.converted == current) {
+            continue;
+        }
+        auto word = Word::from_raw(std::string(prediction.raw));
+        word.set_converted(std::string(prediction.converted));
+        word.protection = ProtectionLevel::PreserveTranslation;
+        chains.emplace_back(WordChain{std::move(word)});
+    }
+    return chains;
+}
+
+auto Engine::record_selection(const std::string_view context, const Word& word) -> void {
+    history.record(context, word.raw(), word.feature());
+    schedule_prediction_refresh();
+}
+
+auto Engine::update_prediction_index(const std::string_view csv) -> void {
+    auto index = std::make_shared<PredictionIndex>();
+    // "raw,0,0,0,converted" per line, the converted part can contain commas
+    for(auto pos = 0uz; pos < csv.size();) {
+        const auto end  = csv.find('\n', pos);
+        const auto line = csv.substr(pos, end - pos);
+        pos             = end == csv.npos ? csv.size() : end + 1;
+
+        auto converted = line.find(',');
+        for(auto i = 0; i < 3 && converted != line.npos; i += 1) {
+            converted = line.find(',', converted + 1);
+        }
+        if(converted != line.npos) {
+            index->add(line.substr(0, line.find(',')), line.substr(converted + 1), 1);
+        }
+    }
+    index->finish();
+    prediction_index.store(std::move(index));
+    update_prediction_delta();
+}
+
+auto Engine::update_prediction_delta() -> void {
+    auto delta = std::make_shared<PredictionIndex>();
+    for(const auto& entry : share.overlay_lexicon.load()->get_entries()) {
+        delta->add(entry.raw, entry.converted, 1);
+    }
+    for(const auto& entry : history.get_entries()) {
+        delta->add(entry.raw, entry.surface, entry.score + 1);
+    }
+    delta->finish();
+    prediction_delta.store(std::move(delta));
+}
+
+auto Engine::schedule_prediction_refresh() -> void {
+    const auto serial = prediction_serial.fetch_add(1) + 1;
+    auto       job    = [this, serial] {
+        if(prediction_serial.load() == serial) {
+            update_prediction_delta();
+        }
+    };
+    worker.post(std::move(job), prediction_refresh_delay);
+}
+
+auto Engine::prepare_user_dictionary() -> std::optional<std::string> {
+    const auto csv = merge_dictionaries();
+    update_prediction_index(csv);
+    if(csv.empty()) {
+        return std::string();
+    }
+    return compile_user_dictionary_cached(csv, system_dictionary_path);
+}
+
+auto Engine::compile_and_reload_user_dictionary() -> bool {
+    auto guard = std::lock_guard(compile_lock);
+
+    // definitions in the overlay at this point will be in the compiled dictionary
+    const auto compiled_serial = share.overlay_lexicon.load()->get_last_serial();
+
+    unwrap(bin_path, prepare_user_dictionary());
+    ensure(reload_dictionary(bin_path.empty() ? nullptr : bin_path.data()));
+    update_overlay_lexicon([compiled_serial](const OverlayLexicon& overlay) { return overlay.compacted(compiled_serial); });
     return true;
 }
 
+auto Engine::compile_and_reload_user_dictionary_background(const std::chrono::milliseconds delay) -> void {
+    // conversions running meanwhile keep using the previous model,
+    // and the new one is published atomically by reload_dictionary()
+    auto job = [this] {
+        if(!compile_and_reload_user_dictionary()) {
+            FCITX_WARN() << "failed to compile user dictionary";
+        }
+    };
+    worker.post(std::move(job), delay);
+}
+
 auto Engine::reload_dictionary(const char* const user_dict) -> bool {
     share.primary_vocabulary = std::make_shared<MeCabModel>(system_dictionary_path.data(), user_dict, true);
+    conversion_cache.clear();
     return true;
 }
 
-auto Engine::convert_wordchain(const WordChain& source, const bool best_only, const bool ignore_protection) const -> WordChains {
-    constexpr auto N_BEST_LIMIT = 30uz;
-
-    auto result                   = WordChains();
+auto Engine::convert_wordchain(const WordChain& source, const bool ignore_protection, IncrementalLattice* const incremental) const -> WordChain {
+    auto       result             = WordChain();
     const auto [raw, constraints] = build_raw_and_constraints(source, ignore_protection);
-    {
-        auto  dic     = share.primary_vocabulary;
-        auto& lattice = *dic->lattice;
-        lattice.set_request_type(best_only ? MECAB_ONE_BEST : MECAB_NBEST);
-        lattice.set_sentence(raw.data());
-        set_constraints(lattice, constraints);
-        dic->tagger->parse(&lattice);
-
-        auto found_features = StringSet();
-        while(1) {
-            auto [features, parsed] = parse_nodes(lattice, true);
-            if(!found_features.contains(features)) {
-                result.emplace_back(parsed);
-                found_features.emplace(std::move(features));
-            }
-            if(!lattice.next() || result.size() >= N_BEST_LIMIT) {
-                break;
-            }
+    // the incremental lattice does not support constraints
+    const auto with_overlay       = incremental != nullptr && constraints.empty();
+    auto       cache_key          = build_cache_key(raw, constraints, 1, with_overlay);
+    const auto generation         = conversion_cache.get_generation();
+    if(auto cached = conversion_cache.find(cache_key)) {
+        result = std::move(cached->front());
+    } else {
+        auto dic = share.primary_vocabulary.load();
+        if(with_overlay && incremental->parse(dic, share.overlay_lexicon.load(), raw)) {
+            result = incremental->best_path();
+        } else {
+            result    = parse_sentence(dic, raw, constraints);
+            cache_key = build_cache_key(raw, constraints, 1, false);
         }
-        lattice.clear();
+        conversion_cache.insert(std::move(cache_key), {result}, generation);
     }
-    if(ignore_protection) {
-        return result;
+    if(!ignore_protection) {
+        retrieve_protection(result, constraints);
     }
+    apply_history(result);
+    return result;
+}
 
-    // retrive protected wordchain
-    for(auto& r : result) {
-        auto total_bytes = 0uz;
-        auto constraint  = constraints.cbegin();
-        for(auto& word : r) {
-            if(constraint == constraints.cend()) {
-                break;
-            }
-            if(total_bytes == constraint->begin) {
-                // this is a word from a protected one
-                word.protection = constraint->word->protection;
-                if(word.protection == ProtectionLevel::PreserveTranslation) {
-                    word = *constraint->word;
-                }
-                constraint += 1;
-            } else if(total_bytes > constraint->begin) {
-                PANIC("protected word lost");
-            }
-            total_bytes += word.raw().size();
+auto Engine::convert_wordchain_nbest(const WordChain& source, const size_t count) const -> NbestPage {
+    auto       page               = NbestPage();
+    const auto generation         = conversion_cache.get_generation();
+    auto       dic                = share.primary_vocabulary.load();
+    const auto [raw, constraints] = build_raw_and_constraints(source, false);
+    auto       cache_key          = build_cache_key(raw, constraints, count, false);
+    if(auto cached = conversion_cache.find(cache_key)) {
+        // only the first page is cached, the rest is generated again when needed
+        page.chains = std::move(*cached);
+        if(page.chains.size() == count && count < share.n_best_limit) {
+            page.rest = std::make_shared<NbestConversion>(std::move(dic), source, count, share.n_best_limit);
+        }
+    } else {
+        page.rest   = std::make_shared<NbestConversion>(std::move(dic), source, 0, share.n_best_limit);
+        page.chains = page.rest->generate(count);
+        conversion_cache.insert(std::move(cache_key), page.chains, generation);
+        if(page.rest->exhausted) {
+            page.rest.reset();
         }
     }
+    for(auto& chain : page.chains) {
+        retrieve_protection(chain, constraints);
+    }
+    if(!page.chains.empty()) {
+        // the best path follows the history like convert_wordchain(), which can make it identical to another one
+        apply_history(page.chains[0]);
+        const auto& best      = page.chains[0];
+        const auto  duplicate = std::remove_if(page.chains.begin() + 1, page.chains.end(), [&](const WordChain& chain) { return is_same_chain(chain, best); });
+        page.chains.erase(duplicate, page.chains.end());
+        if(page.rest) {
+            page.rest->best = best;
+        }
+    }
+    return page;
+}
 
+auto Engine::convert_suffix_heads(const WordChain& chain, IncrementalLattice& lattice) const -> std::vector<Word> {
+    // heads[i] is equal to convert_wordchain({chain[i], chain[i+1], ...})[0]
+    // as long as no words are protected
+    auto raw       = std::string();
+    auto positions = std::vector<size_t>();
+    for(const auto& word : chain) {
+        if(word.protection != ProtectionLevel::None) {
+            return {};
+        }
+        positions.emplace_back(raw.size());
+        raw += word.raw();
+    }
+    if(!lattice.parse(share.primary_vocabulary.load(), share.overlay_lexicon.load(), raw)) {
+        return {};
+    }
+    auto heads = lattice.suffix_heads(positions);
+    // as the first words of convert_wordchain(), with nothing before them
+    for(auto& head : heads) {
+        apply_history(head, {});
+    }
+    return heads;
+}
+
+auto Engine::convert_wordchain_background(WordChain source) -> std::shared_ptr<BackgroundConversion> {
+    auto conversion    = std::make_shared<BackgroundConversion>();
+    conversion->source = std::move(source);
+
+    auto job = [this, conversion] {
+        {
+            auto guard = std::lock_guard(conversion->lock);
+            if(conversion->cancelled) {
+                return;
+            }
+            conversion->started = true;
+        }
+        // the waiter must be woken up even if this fails, the worker only logs the exception
+        auto result = std::optional<NbestPage>();
+        try {
+            result = convert_wordchain_nbest(conversion->source, size_t(share.candidate_page_size));
+        } catch(const std::exception& e) {
+            WARN("background conversion failed: {}", e.what());
+        } catch(...) {
+            WARN("background conversion failed");
+        }
+        {
+            auto guard           = std::lock_guard(conversion->lock);
+            conversion->result   = std::move(result);
+            conversion->finished = true;
+        }
+        conversion->condition.notify_all();
+    };
+    worker.post(std::move(job), std::chrono::milliseconds(share.background_delay));
+    return conversion;
+}
+
+auto Engine::finish_background_conversion(BackgroundConversion& conversion) -> NbestPage {
+    auto guard = std::unique_lock(conversion.lock);
+    if(!conversion.started) {
+        // not started yet, do it here
+        conversion.cancelled = true;
+        guard.unlock();
+        return convert_wordchain_nbest(conversion.source, size_t(share.candidate_page_size));
+    }
+    conversion.condition.wait(guard, [&conversion] { return conversion.finished; });
+    if(!conversion.result) {
+        // failed on the worker, try again here
+        guard.unlock();
+        return convert_wordchain_nbest(conversion.source, size_t(share.candidate_page_size));
+    }
+    auto result = std::move(*conversion.result);
+    conversion.result.reset();
     return result;
 }
 
-auto Engine::add_convert_definition(const std::string_view raw, const std::string_view converted) -> bool {
-    const auto cachedir = get_user_cache_dir();
-    ensure(std::filesystem::is_directory(cachedir) || std::filesystem::create_directories(get_user_cache_dir()));
-    const auto path = cachedir + "/defines.txt";
+auto Engine::acquire_vocabulary(LazyMeCabModel& vocabulary) -> std::shared_ptr<MeCabModel> {
+    const auto [model, loaded] = vocabulary.acquire();
+    if(loaded && share.vocabulary_idle_timeout != 0) {
+        schedule_vocabulary_unload(vocabulary, std::chrono::seconds(share.vocabulary_idle_timeout));
+    }
+    return model;
+}
+
+auto Engine::schedule_vocabulary_unload(LazyMeCabModel& vocabulary, const std::chrono::milliseconds delay) -> void {
+    auto job = [this, &vocabulary] {
+        if(const auto remaining = vocabulary.unload_if_idle(std::chrono::seconds(share.vocabulary_idle_timeout))) {
+            // used meanwhile, check again when it can be idle
+            schedule_vocabulary_unload(vocabulary, *remaining);
+        }
+    };
+    worker.post(std::move(job), delay);
+}
+
+auto Engine::lookup_candidates(const Word& word) -> Word {
+    // hold the models until the lookup finishes, they can be unloaded meanwhile
+    auto models = std::vector<std::shared_ptr<MeCabModel>>{share.primary_vocabulary.load()};
+    for(auto& vocabulary : share.additional_vocabularies) {
+        if(auto model = acquire_vocabulary(*vocabulary)) {
+            models.emplace_back(std::move(model));
+        }
+    }
+    auto dics = std::vector<MeCabModel*>();
+    for(const auto& model : models) {
+        dics.emplace_back(model.get());
+    }
+
+    auto  new_word = Word::from_dictionaries(dics, word);
+    auto& cands    = new_word.candidates;
+    for(const auto& entry : share.overlay_lexicon.load()->find(word.raw())) {
+        if(entry.converted != word.raw() && entry.converted != word.feature()) {
+            emplace_unique(cands, entry.converted);
+        }
+    }
+    // surfaces the user chose before come first
+    if(const auto learned = history.lookup({}, word.raw()); !learned.empty() && !cands.empty()) {
+        const auto score_of = [&learned](const std::string& surface) -> uint32_t {
+            const auto found = std::ranges::find(learned, surface, &HistoryStore::Learned::surface);
+            return found != learned.end() ? found->score : 0;
+        };
+        std::ranges::stable_sort(cands, std::ranges::greater(), score_of);
+    }
+
+    // insert current feature to top, so that the word has candidates even if nothing was found
+    cands.insert(cands.begin(), std::string(word.feature()));
+    // then hiragana
+    if(word.raw() != word.feature()) {
+        cands.insert(cands.begin() + 1, word.raw());
+    }
+    new_word.protection = ProtectionLevel::PreserveTranslation;
+    return new_word;
+}
+
+auto Engine::prefetch_candidates(std::shared_ptr<CandidatePrefetch> prefetch, std::vector<Word> words) -> void {
+    constexpr auto max_prefetched_words = 64uz;
 
+    auto generation = size_t();
     {
-        auto file = std::ofstream(path, std::ios_base::app);
-        std::println(file, "{},{}", raw, converted);
+        auto guard = std::lock_guard(prefetch->lock);
+        prefetch->generation += 1;
+        generation = prefetch->generation;
     }
 
-    ensure(compile_and_reload_user_dictionary());
+    auto job = [this, prefetch, words = std::move(words), generation] {
+        const auto dic     = share.primary_vocabulary.load();
+        const auto overlay = share.overlay_lexicon.load();
+        const auto budget  = std::chrono::milliseconds(share.prefetch_budget);
+        const auto start   = std::chrono::steady_clock::now();
+        for(const auto& word : words) {
+            if(std::chrono::steady_clock::now() - start >= budget) {
+                break;
+            }
+            auto key = CandidatePrefetch::key_of(word);
+            {
+                auto guard = std::lock_guard(prefetch->lock);
+                if(prefetch->generation != generation) {
+                    // the chain was edited
+                    return;
+                }
+                if(prefetch->model != dic || prefetch->overlay != overlay) {
+                    prefetch->words.clear();
+                    prefetch->model   = dic;
+                    prefetch->overlay = overlay;
+                }
+                if(prefetch->words.contains(key)) {
+                    continue;
+                }
+            }
+            auto candidates = lookup_candidates(word);
+            {
+                auto guard = std::lock_guard(prefetch->lock);
+                if(prefetch->generation != generation) {
+                    return;
+                }
+                if(prefetch->words.size() >= max_prefetched_words) {
+                    prefetch->words.clear();
+                }
+                prefetch->words.insert_or_assign(std::move(key), std::move(candidates));
+            }
+        }
+    };
+    worker.post(std::move(job), std::chrono::milliseconds(share.background_delay));
+}
+
+auto Engine::add_convert_definition(const std::string_view raw, const std::string_view converted) -> bool {
+    ensure(defines.add(raw, converted));
+
+    // usable from the next conversion, compiled into the user dictionary later
+    update_overlay_lexicon([raw, converted](const OverlayLexicon& overlay) { return overlay.inserted(std::string(raw), std::string(converted)); });
+    // predictions are refreshed earlier than the compilation
+    schedule_prediction_refresh();
+    // only the job of the last definition compiles
+    const auto serial = definition_serial.fetch_add(1) + 1;
+    auto       job    = [this, serial] {
+        if(definition_serial.load() == serial && !share.overlay_lexicon.load()->empty()) {
+            compile_and_reload_user_dictionary();
+        }
+    };
+    worker.post(std::move(job), overlay_compaction_delay);
     return true;
 }
 
 auto Engine::remove_convert_definition(const std::string_view raw) -> bool {
-    const auto path = get_user_cache_dir() + "/defines.txt";
+    ensure(defines.remove(raw), "no definitions matched");
 
-    auto defs = std::vector<ConvDef>();
-    ensure(load_text_dictionary(path.data(), defs));
-
-    {
-        auto file  = std::ofstream(path, std::ios_base::out);
-        auto count = 0;
-        for(const auto& def : defs) {
-            if(def.raw == raw) {
-                count += 1;
-                continue;
+    update_overlay_lexicon([raw](const OverlayLexicon& overlay) { return overlay.erased(raw); });
+    compile_and_reload_user_dictionary_background();
+    if(defines.needs_compaction()) {
+        auto job = [this] {
+            if(!defines.compact()) {
+                WARN("failed to compact user definitions");
             }
-            std::println(file, "{},{}", def.raw, def.converted);
-        }
-        ensure(count > 0, "no definitions matched");
+        };
+        worker.post(std::move(job));
     }
-    ensure(compile_and_reload_user_dictionary());
     return true;
 }
 
+auto Engine::get_conversion_cache_stats() const -> ConversionCache::Stats {
+    return conversion_cache.get_stats();
+}
+
 Engine::Engine(Share& share)
     : share(share) {
+    auto timer = PhaseTimer();
     ASSERT(load_configuration(), "failed to load configuration");
+    conversion_cache.set_limits(share.conversion_cache_size, share.conversion_cache_memory);
+    timer.lap("configuration");
+
     for(const auto& entry : std::filesystem::directory_iterator(share.dictionary_path)) {
         if(entry.path().filename() == "system") {
             system_dictionary_path = entry.path().string();
         } else {
-            auto new_dic = std::unique_ptr<MeCabModel>();
-            try {
-                new_dic.reset(new MeCabModel(entry.path().string().data(), nullptr, false));
-            } catch(const std::runtime_error&) {
-                FCITX_WARN() << "failed to load addtional dictionary. " << entry.path();
-                continue;
-            }
-            share.additional_vocabularies.push_back(std::move(new_dic));
+            // loaded on the first use
+            share.additional_vocabularies.emplace_back(std::make_unique<LazyMeCabModel>(entry.path().string()));
         }
     }
     ASSERT(!system_dictionary_path.empty(), "failed to find system dictionary");
 
-    if(const auto compiler_path = get_dictionary_compiler_path()) {
-        dictionary_compiler_path = compiler_path.value() + "/mecab-dict-index";
-        compile_and_reload_user_dictionary();
-    } else {
-        FCITX_WARN() << "missing dictionary compiler";
-        reload_dictionary();
+    const auto cache_dir = get_user_cache_dir();
+    if(!(std::filesystem::is_directory(cache_dir) || std::filesystem::create_directories(cache_dir)) || !defines.open(cache_dir + "/defines.txt")) {
+        WARN("failed to open user definitions");
+    }
+    history_file_path = cache_dir + "/history.bin";
+    if(share.history_size != 0 && !history.open(history_file_path, share.history_size)) {
+        WARN("failed to open selection history");
+    }
+    timer.lap("dictionary discovery");
+
+    // merge and compile the user dictionary on the worker while the system dictionary is loaded
+    auto user_dictionary = std::make_shared<std::optional<std::string>>();
+    auto prepare         = [this, user_dictionary] {
+        auto guard       = std::lock_guard(compile_lock);
+        auto timer       = PhaseTimer();
+        *user_dictionary = prepare_user_dictionary();
+        timer.lap("user dictionary preparation");
+    };
+    worker.post(std::move(prepare));
+
+    // start with the system dictionary only, so that typing is not blocked by the compilation
+    reload_dictionary();
+    timer.lap("system dictionary");
+
+    // posted after the reload above, so that the worker runs it after the preparation and it is not overwritten
+    auto job = [this, user_dictionary] {
+        auto        guard = std::lock_guard(compile_lock);
+        auto        timer = PhaseTimer();
+        const auto& path  = *user_dictionary;
+        if(!path) {
+            FCITX_WARN() << "failed to compile user dictionary";
+            return;
+        }
+        reload_dictionary(path->empty() ? nullptr : path->data());
+        timer.lap("user dictionary");
+    };
+    worker.post(std::move(job));
+    if(share.vocabulary_warmup) {
+        auto job = [this] {
+            auto timer = PhaseTimer();
+            auto loads = std::vector<std::future<void>>();
+            for(auto& vocabulary : this->share.additional_vocabularies) {
+                loads.emplace_back(std::async(std::launch::async, [this, &vocabulary] { acquire_vocabulary(*vocabulary); }));
+            }
+            for(auto& load : loads) {
+                load.wait();
+            }
+            timer.lap("vocabulary warm-up");
+        };
+        worker.post(std::move(job));
     }
 
     share.key_config.keys.resize(static_cast<size_t>(Actions::ActionsLimit));
-    share.key_config[Actions::Backspace]         = {{FcitxKey_BackSpace}};
-    share.key_config[Actions::ReinterpretNext]   = {{FcitxKey_space}};
-    share.key_config[Actions::ReinterpretPrev]   = {{FcitxKey_space, fcitx::KeyState::Shift}};
-    share.key_config[Actions::CandidateNext]     = {{FcitxKey_Down}, {FcitxKey_J, fcitx::KeyState::Ctrl}};
-    share.key_config[Actions::CandidatePrev]     = {{FcitxKey_Up}, {FcitxKey_K, fcitx::KeyState::Ctrl}};
-    share.key_config[Actions::CandidatePageNext] = {{FcitxKey_Left}};
-    share.key_config[Actions::CandidatePagePrev] = {{FcitxKey_Right}};
-    share.key_config[Actions::Commit]            = {{FcitxKey_Return}};
-    share.key_config[Actions::WordNext]          = {{FcitxKey_Left}, {FcitxKey_L, fcitx::KeyState::Ctrl}};
-    share.key_config[Actions::WordPrev]          = {{FcitxKey_Right}, {FcitxKey_H, fcitx::KeyState::Ctrl}};
-    share.key_config[Actions::SplitWordLeft]     = {{FcitxKey_H, fcitx::KeyState::Alt}};
-    share.key_config[Actions::SplitWordRight]    = {{FcitxKey_L, fcitx::KeyState::Alt}};
-    share.key_config[Actions::MergeWordsLeft]    = {{FcitxKey_J, fcitx::KeyState::Alt}};
-    share.key_config[Actions::MergeWordsRight]   = {{FcitxKey_K, fcitx::KeyState::Alt}};
-    share.key_config[Actions::GiveToLeft]        = {{FcitxKey_J, fcitx::KeyState::Ctrl_Alt}};
-    share.key_config[Actions::GiveToRight]       = {{FcitxKey_K, fcitx::KeyState::Ctrl_Alt}};
-    share.key_config[Actions::TakeFromLeft]      = {{FcitxKey_H, fcitx::KeyState::Ctrl_Alt}};
-    share.key_config[Actions::TakeFromRight]     = {{FcitxKey_L, fcitx::KeyState::Ctrl_Alt}};
-    share.key_config[Actions::ConvertKatakana]   = {{FcitxKey_q}}; // not Q
-    share.key_config[Actions::EnterCommandMode]  = {{FcitxKey_slash}};
-    share.key_config[Actions::ExitCommandMode]   = {{FcitxKey_Escape}};
+    share.key_config[Actions::Backspace]                = {{FcitxKey_BackSpace}};
+    share.key_config[Actions::ReinterpretNext]          = {{FcitxKey_space}};
+    share.key_config[Actions::ReinterpretPrev]          = {{FcitxKey_space, fcitx::KeyState::Shift}};
+    share.key_config[Actions::CandidateNext]            = {{FcitxKey_Down}, {FcitxKey_J, fcitx::KeyState::Ctrl}};
+    share.key_config[Actions::CandidatePrev]            = {{FcitxKey_Up}, {FcitxKey_K, fcitx::KeyState::Ctrl}};
+    share.key_config[Actions::CandidatePageNext]        = {{FcitxKey_Left}};
+    share.key_config[Actions::CandidatePagePrev]        = {{FcitxKey_Right}};
+    share.key_config[Actions::Commit]                   = {{FcitxKey_Return}};
+    share.key_config[Actions::WordNext]                 = {{FcitxKey_Left}, {FcitxKey_L, fcitx::KeyState::Ctrl}};
+    share.key_config[Actions::WordPrev]                 = {{FcitxKey_Right}, {FcitxKey_H, fcitx::KeyState::Ctrl}};
+    share.key_config[Actions::SplitWordLeft]            = {{FcitxKey_H, fcitx::KeyState::Alt}};
+    share.key_config[Actions::SplitWordRight]           = {{FcitxKey_L, fcitx::KeyState::Alt}};
+    share.key_config[Actions::MergeWordsLeft]           = {{FcitxKey_J, fcitx::KeyState::Alt}};
+    share.key_config[Actions::MergeWordsRight]          = {{FcitxKey_K, fcitx::KeyState::Alt}};
+    share.key_config[Actions::GiveToLeft]               = {{FcitxKey_J, fcitx::KeyState::Ctrl_Alt}};
+    share.key_config[Actions::GiveToRight]              = {{FcitxKey_K, fcitx::KeyState::Ctrl_Alt}};
+    share.key_config[Actions::TakeFromLeft]             = {{FcitxKey_H, fcitx::KeyState::Ctrl_Alt}};
+    share.key_config[Actions::TakeFromRight]            = {{FcitxKey_L, fcitx::KeyState::Ctrl_Alt}};
+    share.key_config[Actions::ConvertKatakana]          = {{FcitxKey_q}}; // not Q
+    share.key_config[Actions::ConvertChainHiragana]     = {{FcitxKey_F6}};
+    share.key_config[Actions::ConvertChainKatakana]     = {{FcitxKey_F7}};
+    share.key_config[Actions::ConvertChainHalfKatakana] = {{FcitxKey_F8}};
+    share.key_config[Actions::ConvertChainFullAscii]    = {{FcitxKey_F9}};
+    share.key_config[Actions::Predict]                  = {{FcitxKey_Tab}};
+    share.key_config[Actions::EnterCommandMode]         = {{FcitxKey_slash}};
+    share.key_config[Actions::ExitCommandMode]          = {{FcitxKey_Escape}};
 }
 } // namespace mikan::engine
@@ -1,6 +1,12 @@
 #pragma once
+#include "conversion-cache.hpp"
+#include "defines-store.hpp"
+#include "history-store.hpp"
+#include "incremental-lattice.hpp"
+#include "prediction-index.hpp"
 #include "share.hpp"
 #include "word.hpp"
+#include "worker.hpp"
 
 namespace mikan::engine {
 struct FeatureConstriant {
@@ -9,29 +15,140 @@ struct FeatureConstriant {
     const Word* word;
 };
 
+// points into the source of the definition
 struct ConvDef {
-    std::string raw;
-    std::string converted;
+    std::string_view raw;
+    std::string_view converted;
+};
+
+// n-best paths of a sentence, generated on demand as the candidate list pages forward
+class NbestConversion {
+  private:
+    friend class Engine;
+
+    // a word of a path, pointing into the lattice sentence and the dictionary.
+    // paths are kept in this form until they survive deduplication.
+    struct NodeView {
+        std::string_view surface;
+        const char*      feature;
+        bool             unknown;
+    };
+
+    using Fingerprints = std::unordered_multimap<uint64_t, std::pair<size_t, size_t>>; // -> range in accepted
+
+    std::shared_ptr<MeCabModel>    model;
+    MeCabModel::PooledLattice      lattice; // acquired on the first generation, released when exhausted
+    WordChain                      source;
+    std::string                    raw;
+    std::vector<FeatureConstriant> constraints; // points to source
+    std::vector<NodeView>          nodes;       // scratch
+    std::vector<NodeView>          accepted;
+    Fingerprints                   found;
+    size_t                         skip;  // paths delivered from elsewhere, such as the cache
+    size_t                         limit; // maximum number of unique paths
+    size_t                         generated = 0;
+    bool                           exhausted = false;
+    WordChain                      best; // the first path with the history applied, which may equal a later one
+
+    auto generate(size_t count) -> WordChains;
+
+  public:
+    // next count paths at most, fewer only when exhausted
+    auto pull(size_t count) -> WordChains;
+
+    NbestConversion(std::shared_ptr<MeCabModel> model, const WordChain& source, size_t skip, size_t limit);
+};
+
+// first page of n-best paths, and the generator of the following ones. rest is null when there are no more
+struct NbestPage {
+    WordChains                       chains;
+    std::shared_ptr<NbestConversion> rest;
+};
+
+// n-best conversion running on the worker thread
+struct BackgroundConversion {
+    WordChain                source;
+    std::mutex               lock;
+    std::condition_variable  condition;
+    std::optional<NbestPage> result; // empty after finished if the conversion failed
+    bool                     started   = false;
+    bool                     finished  = false;
+    bool                     cancelled = false;
+
+    auto cancel() -> void;
+    auto is_for(const WordChain& chain) const -> bool;
+};
+
+// per-word candidates prepared on the worker thread
+class CandidatePrefetch {
+  private:
+    friend class Engine;
+
+    using Words = std::unordered_map<std::string, Word, internal::StringHash, std::ranges::equal_to>;
+
+    std::mutex                            lock;
+    std::shared_ptr<MeCabModel>           model; // the dictionary which words are looked up with
+    std::shared_ptr<const OverlayLexicon> overlay;
+    Words                                 words;
+    size_t                                generation = 0;
+
+  public:
+    static auto key_of(const Word& word) -> std::string;
+
+    auto find(const Word& word, const std::shared_ptr<MeCabModel>& current_model, const std::shared_ptr<const OverlayLexicon>& current_overlay) -> std::optional<Word>;
+    auto cancel() -> void;
 };
 
 class Engine {
   private:
-    Share&                   share;
-    std::string              system_dictionary_path;
-    std::string              history_file_path;
-    std::string              dictionary_compiler_path;
-    std::vector<std::string> user_dictionary_paths;
+    Share&                                              share;
+    std::string                                         system_dictionary_path;
+    std::string                                         history_file_path;
+    std::vector<std::string>                            user_dictionary_paths;
+    mutable ConversionCache                             conversion_cache;
+    DefinesStore                                        defines;
+    HistoryStore                                        history;
+    std::atomic<std::shared_ptr<const PredictionIndex>> prediction_index;  // the dictionaries, rebuilt with the user dictionary
+    std::atomic<std::shared_ptr<const PredictionIndex>> prediction_delta;  // the history and the uncompiled definitions, rebuilt after selections and definitions
+    std::atomic_size_t                                  prediction_serial; // bumped by each refresh request, to rebuild once after the last one
+    std::mutex                                          compile_lock;      // the compiler is not reentrant, held by the jobs which prepare or reload the user dictionary
+    std::atomic_size_t                                  definition_serial; // bumped by each definition, to compile once after the last one
+    Worker                                              worker;            // must be the last member, so that jobs finish before the others are destroyed
 
     auto parse_configuration_line(std::string_view line) -> bool;
     auto load_configuration() -> bool;
-    auto merge_dictionaries(const char* path) const -> bool;
+    auto merge_dictionaries() const -> std::string;
+    auto update_prediction_index(std::string_view csv) -> void;
+    auto update_prediction_delta() -> void;
+    auto schedule_prediction_refresh() -> void;
+    // path to the compiled user dictionary, empty if there is nothing to compile
+    auto prepare_user_dictionary() -> std::optional<std::string>;
+    // makes the words follow the selection history, unless protected
+    // context is the feature of the word before
+    auto apply_history(Word& word, std::string_view context) const -> void;
+    auto apply_history(WordChain& chain) const -> void;
+    auto update_overlay_lexicon(const std::function<OverlayLexicon(const OverlayLexicon&)>& modify) -> void;
+    auto acquire_vocabulary(LazyMeCabModel& vocabulary) -> std::shared_ptr<MeCabModel>;
+    auto schedule_vocabulary_unload(LazyMeCabModel& vocabulary, std::chrono::milliseconds delay) -> void;
 
   public:
     auto compile_and_reload_user_dictionary() -> bool;
+    auto compile_and_reload_user_dictionary_background(std::chrono::milliseconds delay = {}) -> void;
     auto reload_dictionary(const char* user_dict = nullptr) -> bool;
-    auto convert_wordchain(const WordChain& source, bool best_only, bool ignore_protection = false) const -> WordChains;
+    auto convert_wordchain(const WordChain& source, bool ignore_protection = false, IncrementalLattice* incremental = nullptr) const -> WordChain;
+    auto convert_wordchain_nbest(const WordChain& source, size_t count) const -> NbestPage;
+    auto convert_suffix_heads(const WordChain& chain, IncrementalLattice& lattice) const -> std::vector<Word>;
+    auto convert_wordchain_background(WordChain source) -> std::shared_ptr<BackgroundConversion>;
+    auto finish_background_conversion(BackgroundConversion& conversion) -> NbestPage;
+    auto lookup_candidates(const Word& word) -> Word;
+    auto prefetch_candidates(std::shared_ptr<CandidatePrefetch> prefetch, std::vector<Word> words) -> void;
+    // words starting with the reading of the chain, as single word chains
+    auto predict(const WordChain& chain, size_t count) const -> WordChains;
+    // context is the feature of the word committed before
+    auto record_selection(std::string_view context, const Word& word) -> void;
     auto add_convert_definition(std::string_view raw, std::string_view converted) -> bool;
     auto remove_convert_definition(std::string_view raw) -> bool;
+    auto get_conversion_cache_stats() const -> ConversionCache::Stats;
 
     Engine(Share& share);
 };
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <span>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "history-store.hpp"
+#include "macros/assert.hpp"
+#include "misc.hpp"
+
+namespace mikan::engine {
+struct HistoryStore::Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t capacity; // number of slots, a power of two
+    uint32_t clock;    // number of records
+    uint32_t reserved;
+};
+
+struct HistoryStore::Slot {
+    uint64_t key;   // hash of the context and the reading, 0 if empty
+    uint32_t count; // as of stamp
+    uint32_t stamp; // clock of the last update
+    char     text[48]; // reading and surface, each terminated by a null
+
+    // bounded, the file can be broken
+    auto get_raw() const -> std::string_view {
+        return std::string_view(text, strnlen(text, sizeof(text) - 1));
+    }
+
+    auto get_surface() const -> std::string_view {
+        const auto begin = get_raw().size() + 1;
+        return std::string_view(text + begin, strnlen(text + begin, sizeof(text) - begin));
+    }
+};
+
+namespace {
+constexpr auto magic        = std::string_view("mikanhis", 8);
+constexpr auto version      = uint32_t(2);
+constexpr auto probe_window = 16uz;
+constexpr auto max_count    = uint32_t(1) << 16;
+constexpr auto context_rate = uint32_t(2); // weight of the counts with the same preceding word
+
+auto key_of(const std::string_view context, const std::string_view raw) -> uint64_t {
+    // 0xff never appears in utf-8
+    const auto hash = fnv1a(raw, fnv1a(std::string_view("\xff", 1), fnv1a(context)));
+    return hash == 0 ? 1 : hash;
+}
+} // namespace
+
+struct HistoryStore::Scores {
+    struct Scored {
+        std::string_view surface;
+        uint32_t         score;
+    };
+
+    std::array<Scored, probe_window * 2> items; // a probe window with and without the context
+    size_t                               size = 0;
+
+    auto get() const -> std::span<const Scored> {
+        return std::span(items).first(size);
+    }
+};
+
+auto HistoryStore::decayed(const Slot& slot) const -> uint32_t {
+    const auto periods = (header->clock - slot.stamp) / header->capacity;
+    return periods >= 32 ? 0 : slot.count >> periods;
+}
+
+auto HistoryStore::record_with(const uint64_t key, const std::string_view raw, const std::string_view surface) -> void {
+    const auto mask   = header->capacity - 1;
+    auto       victim = (Slot*)(nullptr);
+    for(auto i = 0uz; i < probe_window; i += 1) {
+        auto& slot = slots[(key + i) & mask];
+        if(slot.key == key && slot.get_raw() == raw && slot.get_surface() == surface) {
+            slot.count = std::min(decayed(slot) + 1, max_count);
+            slot.stamp = header->clock;
+            return;
+        }
+        if(victim == nullptr || (victim->key != 0 && (slot.key == 0 || decayed(slot) < decayed(*victim)))) {
+            victim = &slot;
+        }
+    }
+    victim->key   = key;
+    victim->count = 1;
+    victim->stamp = header->clock;
+    std::memset(victim->text, 0, sizeof(victim->text));
+    std::memcpy(victim->text, raw.data(), raw.size());
+    std::memcpy(victim->text + raw.size() + 1, surface.data(), surface.size());
+}
+
+auto HistoryStore::close() -> void {
+    if(header != nullptr) {
+        munmap(header, mapped);
+        header = nullptr;
+        slots  = nullptr;
+        mapped = 0;
+    }
+}
+
+auto HistoryStore::open(const std::string& path, const size_t capacity) -> bool {
+    auto guard = std::lock_guard(lock);
+    close();
+
+    const auto slot_count = std::bit_ceil(std::max(capacity, probe_window));
+    const auto size       = sizeof(Header) + slot_count * sizeof(Slot);
+
+    const auto fd = ::open(path.data(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    ensure(fd >= 0, "failed to open {}: {}", path, strerror(errno));
+    struct stat st = {};
+    const auto  ok = fstat(fd, &st) == 0 && (size_t(st.st_size) == size || ftruncate(fd, size) == 0);
+    const auto map = ok ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    ensure(map != MAP_FAILED, "failed to map {}", path);
+
+    header = static_cast<Header*>(map);
+    slots  = reinterpret_cast<Slot*>(header + 1);
+    mapped = size;
+    if(magic != std::string_view(header->magic, sizeof(header->magic)) || header->version != version || header->capacity != slot_count) {
+        std::memset(map, 0, size);
+        std::memcpy(header->magic, magic.data(), magic.size());
+        header->version  = version;
+        header->capacity = slot_count;
+    }
+    return true;
+}
+
+auto HistoryStore::record(const std::string_view context, const std::string_view raw, const std::string_view surface) -> void {
+    auto guard = std::lock_guard(lock);
+    if(header == nullptr || raw.empty() || surface.empty()) {
+        return;
+    }
+    if(raw.size() + surface.size() + 2 > sizeof(Slot::text)) {
+        WARN("not learning {}({}), longer than {} bytes", surface, raw, sizeof(Slot::text) - 2);
+        return;
+    }
+    header->clock += 1;
+    record_with(key_of({}, raw), raw, surface);
+    if(!context.empty()) {
+        record_with(key_of(context, raw), raw, surface);
+    }
+}
+
+auto HistoryStore::collect(const std::string_view context, const std::string_view raw, Scores& scores) const -> void {
+    const auto collect_key = [this, &scores, raw](const uint64_t key, const uint32_t rate) {
+        const auto mask = header->capacity - 1;
+        for(auto i = 0uz; i < probe_window; i += 1) {
+            const auto& slot  = slots[(key + i) & mask];
+            const auto  score = slot.key == key && slot.get_raw() == raw ? decayed(slot) * rate : 0;
+            if(score == 0) {
+                continue;
+            }
+            const auto surface = slot.get_surface();
+            const auto items   = std::span(scores.items).first(scores.size);
+            const auto found   = std::ranges::find(items, surface, &Scores::Scored::surface);
+            if(found != items.end()) {
+                found->score += score;
+            } else {
+                scores.items[scores.size] = {surface, score};
+                scores.size += 1;
+            }
+        }
+    };
+    collect_key(key_of({}, raw), 1);
+    if(!context.empty()) {
+        collect_key(key_of(context, raw), context_rate);
+    }
+}
+
+auto HistoryStore::lookup(const std::string_view context, const std::string_view raw) const -> std::vector<Learned> {
+    auto result = std::vector<Learned>();
+    auto guard  = std::lock_guard(lock);
+    if(header == nullptr) {
+        return result;
+    }
+    auto scores = Scores();
+    collect(context, raw, scores);
+    for(const auto& [surface, score] : scores.get()) {
+        result.emplace_back(Learned{std::string(surface), score});
+    }
+    std::ranges::stable_sort(result, std::ranges::greater(), &Learned::score);
+    return result;
+}
+
+auto HistoryStore::find_preferred(const std::string_view context, const std::string_view raw, const std::string_view current) const -> std::optional<std::string> {
+    auto guard = std::lock_guard(lock);
+    if(header == nullptr) {
+        return std::nullopt;
+    }
+    auto scores = Scores();
+    collect(context, raw, scores);
+    // the first of the highest, as lookup() sorts stably
+    const auto items = scores.get();
+    const auto top   = std::ranges::max_element(items, [](const auto& a, const auto& b) { return a.score < b.score; });
+    if(top == items.end() || top->surface == current) {
+        return std::nullopt;
+    }
+    // replace only when the top one scores higher than the current one
+    const auto found = std::ranges::find(items, current, &Scores::Scored::surface);
+    if(found != items.end() && found->score >= top->score) {
+        return std::nullopt;
+    }
+    return std::string(top->surface);
+}
+
+auto HistoryStore::get_entries() const -> std::vector<Entry> {
+    auto result = std::vector<Entry>();
+    auto guard  = std::lock_guard(lock);
+    if(header == nullptr) {
+        return result;
+    }
+    for(auto i = 0uz; i < header->capacity; i += 1) {
+        const auto& slot = slots[i];
+        // the entries with a context are duplicates of the ones without
+        if(slot.key == 0 || slot.key != key_of({}, slot.get_raw())) {
+            continue;
+        }
+        if(const auto score = decayed(slot); score != 0) {
+            result.emplace_back(Entry{std::string(slot.get_raw()), std::string(slot.get_surface()), score});
+        }
+    }
+    return result;
+}
+
+HistoryStore::~HistoryStore() {
+    close();
+}
+} // namespace mikan::engine
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mikan::engine {
+// counts of the surfaces the user committed for each reading, with and without the preceding word.
+// stored as a fixed size hash table in a memory mapped file, so that recording is a few memory writes.
+// when a probe window is full, the entry with the lowest count is replaced.
+// counts are halved each time as many records as the table capacity are made.
+// the reading and the surface share 46 bytes in a slot, about 7 kana each, and longer pairs are not recorded.
+// safe to be used from multiple threads
+class HistoryStore {
+  public:
+    struct Learned {
+        std::string surface;
+        uint32_t    score;
+    };
+
+    struct Entry {
+        std::string raw;
+        std::string surface;
+        uint32_t    score;
+    };
+
+  private:
+    struct Header;
+    struct Slot;
+    struct Scores;
+
+    mutable std::mutex lock;
+    Header*            header = nullptr; // mapped file, followed by slots
+    Slot*              slots  = nullptr;
+    size_t             mapped = 0; // bytes
+
+    auto decayed(const Slot& slot) const -> uint32_t;
+    // sums the scores of each surface into scores, in the order of the probes. the surfaces point into the slots
+    auto collect(std::string_view context, std::string_view raw, Scores& scores) const -> void;
+    auto record_with(uint64_t key, std::string_view raw, std::string_view surface) -> void;
+    auto close() -> void;
+
+  public:
+    // capacity is rounded up to a power of two. an existing file with another capacity is discarded
+    auto open(const std::string& path, size_t capacity) -> bool;
+    auto record(std::string_view context, std::string_view raw, std::string_view surface) -> void;
+    // surfaces learned for the reading, highest score first
+    auto lookup(std::string_view context, std::string_view raw) const -> std::vector<Learned>;
+    // the top learned surface if it is preferred over current, without allocating otherwise
+    auto find_preferred(std::string_view context, std::string_view raw, std::string_view current) const -> std::optional<std::string>;
+    // every reading and surface pair, regardless of the context
+    auto get_entries() const -> std::vector<Entry>;
+
+    ~HistoryStore();
+};
+} // namespace mikan::engine
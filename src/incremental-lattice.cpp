@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <limits>
+
+#include "incremental-lattice.hpp"
+#include "macros/assert.hpp"
+
+namespace mikan {
+namespace {
+constexpr auto invalid_index = uint32_t(-1);
+constexpr auto infinite_cost = std::numeric_limits<long>::max();
+
+// bytes a lookup reads from its position at most.
+// covers mecab's unknown word grouping limit of 24 characters, and is longer than the words of the dictionaries.
+constexpr auto max_lookup_bytes = 256uz;
+} // namespace
+
+auto IncrementalLattice::truncate(const size_t pos, const size_t length) -> void {
+    // nodes[0] is bos, which is kept unless everything is dropped
+    const auto first = pos == 0 ? 0uz : size_t(std::partition_point(nodes.begin() + 1, nodes.end(), [pos](const Node& node) { return node.begin < pos; }) - nodes.begin());
+    nodes.resize(first);
+
+    // nodes ending at pos or before begin before pos
+    end_nodes.resize(length + 1);
+    for(auto i = pos + 1; i < end_nodes.size(); i += 1) {
+        auto& list = end_nodes[i];
+        while(!list.empty() && list.back() >= first) {
+            list.pop_back();
+        }
+    }
+    if(pos == 0) {
+        end_nodes[0].clear();
+    }
+    // connections at pos or later can see the dropped nodes
+    connections.resize(length + 1);
+    for(auto i = pos; i < connections.size(); i += 1) {
+        connections[i].clear();
+    }
+    eos_prev_pos = 0;
+    eos_prev     = invalid_index;
+}
+
+auto IncrementalLattice::connect(const size_t pos, const unsigned short lcattr, const short wcost) -> Connection {
+    const auto match = [lcattr, wcost](const Connection& c) { return c.lcattr == lcattr && c.wcost == wcost; };
+
+    auto& list = connections[pos];
+    if(const auto p = std::ranges::find_if(list, match); p != list.end()) {
+        return *p;
+    }
+
+    // same as MeCab::Viterbi::connect
+    auto        best_cost = 2147483647l;
+    auto        best      = invalid_index;
+    const auto& lnodes    = end_nodes[pos];
+    for(auto i = lnodes.size(); i > 0; i -= 1) {
+        const auto& lnode = nodes[lnodes[i - 1]];
+        const auto  cost  = lnode.cost + model->model->transition_cost(lnode.rcattr, lcattr) + wcost;
+        if(cost < best_cost) {
+            best_cost = cost;
+            best      = i - 1;
+        }
+    }
+    return list.emplace_back(Connection{lcattr, wcost, best_cost, best});
+}
+
+auto IncrementalLattice::parse(std::shared_ptr<MeCabModel> new_model, std::shared_ptr<const OverlayLexicon> new_overlay, const std::string_view new_sentence) -> bool {
+    // analysis of the positions whose lookups can not see the edit is kept
+    auto keep = 0uz;
+    if(model != new_model) {
+        model = std::move(new_model);
+        owner.reset();
+        scratch.reset(model->model->createLattice());
+    } else if(overlay != new_overlay) {
+        // words changed, nothing can be reused
+    } else if(sentence == new_sentence && eos_prev != invalid_index) {
+        return true;
+    } else {
+        const auto common    = size_t(std::ranges::mismatch(sentence, new_sentence).in1 - sentence.begin());
+        const auto lookahead = std::max(max_lookup_bytes, overlay ? overlay->get_max_raw_length() : 0uz);
+        keep                 = common > lookahead ? common - lookahead : 0;
+    }
+    if(owner == nullptr || overlay != new_overlay) {
+        owner = std::make_shared<const Owner>(model, new_overlay);
+    }
+    overlay = std::move(new_overlay);
+    truncate(keep, new_sentence.size());
+    sentence = new_sentence;
+
+    const auto begin = sentence.data();
+    const auto end   = begin + sentence.size();
+
+    // bos
+    if(nodes.empty()) {
+        nodes.emplace_back(Node{.begin = 0, .end = 0, .surface = 0, .length = 0, .feature = nullptr, .cost = 0, .prev = invalid_index, .wcost = 0, .lcattr = 0, .rcattr = 0, .stat = MECAB_BOS_NODE});
+        end_nodes[0].emplace_back(0);
+    }
+
+    // same as MeCab::Viterbi::viterbi, from the first position which can be affected
+    for(auto pos = keep; pos < sentence.size(); pos += 1) {
+        if(end_nodes[pos].empty()) {
+            continue;
+        }
+        for(auto node = model->model->lookup(begin + pos, end, scratch.get()); node != nullptr; node = node->bnext) {
+            const auto connection = connect(pos, node->lcAttr, node->wcost);
+            if(connection.prev == invalid_index) {
+                scratch->clear();
+                truncate(0, 0);
+                sentence.clear();
+                bail("failed to connect node");
+            }
+            const auto node_end = pos + node->rlength;
+            end_nodes[node_end].emplace_back(nodes.size());
+            nodes.emplace_back(Node{
+                .begin   = pos,
+                .end     = node_end,
+                .surface = size_t(node->surface - begin),
+                .length  = node->length,
+                .feature = node->feature,
+                .cost    = connection.cost,
+                .prev    = connection.prev,
+                .wcost   = node->wcost,
+                .lcattr  = node->lcAttr,
+                .rcattr  = node->rcAttr,
+                .stat    = node->stat,
+            });
+        }
+        if(overlay) {
+            // same parameters as the compiled user dictionary entries
+            overlay->common_prefix_search(std::string_view(sentence).substr(pos), [&](const OverlayLexicon::Entry& entry) {
+                const auto connection = connect(pos, 0, 0);
+                const auto node_end   = pos + entry.raw.size();
+                end_nodes[node_end].emplace_back(nodes.size());
+                nodes.emplace_back(Node{
+                    .begin   = pos,
+                    .end     = node_end,
+                    .surface = pos,
+                    .length  = entry.raw.size(),
+                    .feature = entry.converted.data(),
+                    .cost    = connection.cost,
+                    .prev    = connection.prev,
+                    .wcost   = 0,
+                    .lcattr  = 0,
+                    .rcattr  = 0,
+                    .stat    = MECAB_NOR_NODE,
+                });
+            });
+        }
+    }
+    scratch->clear();
+
+    // eos
+    for(auto pos = sentence.size() + 1; pos > 0; pos -= 1) {
+        if(end_nodes[pos - 1].empty()) {
+            continue;
+        }
+        const auto connection = connect(pos - 1, 0, 0);
+        ensure(connection.prev != invalid_index, "failed to connect eos");
+        eos_prev_pos = pos - 1;
+        eos_prev     = connection.prev;
+        return true;
+    }
+    bail("no path to eos");
+}
+
+auto IncrementalLattice::best_path() const -> WordChain {
+    auto chain = WordChain();
+    if(eos_prev == invalid_index) {
+        return chain;
+    }
+    auto pos  = size_t(eos_prev_pos);
+    auto prev = eos_prev;
+    while(true) {
+        const auto& node = nodes[end_nodes[pos][prev]];
+        if(node.stat == MECAB_BOS_NODE) {
+            break;
+        }
+        const auto surface = std::string_view(sentence).substr(node.surface, node.length);
+        chain.emplace_back(Word::from_node(surface, node.feature, node.stat == MECAB_UNK_NODE, owner));
+        pos  = node.begin;
+        prev = node.prev;
+    }
+    std::ranges::reverse(chain);
+    return chain;
+}
+
+auto IncrementalLattice::suffix_heads(const std::span<const size_t> positions) const -> std::vector<Word> {
+    const auto size = sentence.size();
+    if(eos_prev == invalid_index || eos_prev_pos != size) {
+        return {};
+    }
+
+    // nodes except bos are sorted by their begin positions
+    auto first_node = std::vector<size_t>(size + 2);
+    for(auto pos = 0uz, i = 1uz; pos < first_node.size(); pos += 1) {
+        while(i < nodes.size() && nodes[i].begin < pos) {
+            i += 1;
+        }
+        first_node[pos] = i;
+    }
+
+    // backward pass, cost from each node to eos
+    auto cost_to_eos = std::vector<long>(nodes.size(), infinite_cost);
+    for(auto i = nodes.size(); i > 1; i -= 1) {
+        const auto& node = nodes[i - 1];
+        if(node.end == size) {
+            cost_to_eos[i - 1] = model->model->transition_cost(node.rcattr, 0);
+            continue;
+        }
+        for(auto j = first_node[node.end]; j < first_node[node.end + 1]; j += 1) {
+            if(cost_to_eos[j] == infinite_cost) {
+                continue;
+            }
+            const auto& rnode = nodes[j];
+            const auto  cost  = model->model->transition_cost(node.rcattr, rnode.lcattr) + rnode.wcost + cost_to_eos[j];
+            cost_to_eos[i - 1] = std::min(cost_to_eos[i - 1], cost);
+        }
+    }
+
+    // connect a new bos to each position
+    auto heads = std::vector<Word>();
+    for(const auto pos : positions) {
+        ensure(pos < size, "invalid position");
+        auto best_cost = infinite_cost;
+        auto best      = 0uz;
+        for(auto j = first_node[pos]; j < first_node[pos + 1]; j += 1) {
+            if(cost_to_eos[j] == infinite_cost) {
+                continue;
+            }
+            const auto& rnode = nodes[j];
+            const auto  cost  = model->model->transition_cost(0, rnode.lcattr) + rnode.wcost + cost_to_eos[j];
+            if(cost < best_cost) {
+                best_cost = cost;
+                best      = j;
+            }
+        }
+        ensure(best_cost != infinite_cost, "no path from position {}", pos);
+        const auto& node    = nodes[best];
+        const auto  surface = std::string_view(sentence).substr(node.surface, node.length);
+        heads.emplace_back(Word::from_node(surface, node.feature, node.stat == MECAB_UNK_NODE, owner));
+    }
+    return heads;
+}
+} // namespace mikan
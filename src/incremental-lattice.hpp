@@ -0,0 +1,64 @@
+#pragma once
+#include <span>
+#include <string>
+#include <vector>
+
+#include "mecab-model.hpp"
+#include "overlay-lexicon.hpp"
+#include "word.hpp"
+
+namespace mikan {
+// a lattice which keeps the viterbi state between parses,
+// so that only the suffix affected by an edit is looked up and connected again.
+// it reproduces the 1-best result of MeCab::Tagger without constraints,
+// with words of the overlay lexicon added as if they were in the user dictionary.
+class IncrementalLattice {
+  private:
+    struct Node {
+        size_t         begin;   // byte offset of the node
+        size_t         end;     // byte offset after the node, including leading spaces
+        size_t         surface; // byte offset of the surface
+        size_t         length;  // byte length of the surface
+        const char*    feature; // owned by the model
+        long           cost;
+        uint32_t       prev; // index in end_nodes[begin]
+        short          wcost;
+        unsigned short lcattr;
+        unsigned short rcattr;
+        unsigned char  stat;
+    };
+
+    struct Connection {
+        unsigned short lcattr;
+        short          wcost;
+        long           cost;
+        uint32_t       prev;
+    };
+
+    // keeps the features of the words from best_path() and suffix_heads() alive
+    using Owner = std::pair<std::shared_ptr<MeCabModel>, std::shared_ptr<const OverlayLexicon>>;
+
+    std::shared_ptr<MeCabModel>           model;
+    std::shared_ptr<const OverlayLexicon> overlay;
+    std::shared_ptr<const Owner>          owner;
+    std::unique_ptr<MeCab::Lattice>       scratch; // only used as a node allocator of lookups
+    std::string                           sentence;
+    std::vector<Node>                     nodes;       // sorted by begin, bos first
+    std::vector<std::vector<uint32_t>>    end_nodes;   // indices in nodes, in mecab's insertion order
+    std::vector<std::vector<Connection>>  connections; // connection results per begin position
+    uint32_t                              eos_prev_pos = 0;
+    uint32_t                              eos_prev     = uint32_t(-1);
+
+    // drops the nodes beginning at pos or later, and resizes the per position lists for length
+    auto truncate(size_t pos, size_t length) -> void;
+    auto connect(size_t pos, unsigned short lcattr, short wcost) -> Connection;
+
+  public:
+    // overlay can be null
+    auto parse(std::shared_ptr<MeCabModel> model, std::shared_ptr<const OverlayLexicon> overlay, std::string_view sentence) -> bool;
+    auto best_path() const -> WordChain;
+    // first word of the best path of each sentence starting at the given byte positions,
+    // as if the text before it did not exist. empty on failure.
+    auto suffix_heads(std::span<const size_t> positions) const -> std::vector<Word>;
+};
+} // namespace mikan
@@ -0,0 +1,114 @@
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "kana.hpp"
+#include "utf8.hpp"
+
+namespace mikan::kana {
+namespace {
+// hiragana U+3041-3096 and katakana U+30A1-30F6 are 0x60 apart, and so are the iteration marks U+309D-309E and U+30FD-30FE.
+// all of them are e3 xx yy in utf-8, where 0x60 is +1 on xx and +0x20 on yy, or +2 and -0x20 if yy carries over.
+// a range is given by the two bytes after the lead, as (xx << 8 | yy)
+struct TailRange {
+    uint16_t first;
+    uint16_t last;
+
+    auto contains(const uint16_t tail) const -> uint8_t {
+        return uint16_t(tail - first) <= uint16_t(last - first);
+    }
+};
+
+constexpr auto hiragana_ranges = std::array{TailRange{0x8181, 0x8296}, TailRange{0x829d, 0x829e}};
+constexpr auto katakana_ranges = std::array{TailRange{0x82a1, 0x83b6}, TailRange{0x83bd, 0x83be}};
+
+// both loops only read the input, so they can be vectorized
+template <bool forward>
+auto shift_kana(const std::string_view str, const std::array<TailRange, 2>& ranges) -> std::string {
+    const auto size  = str.size();
+    const auto bytes = reinterpret_cast<const uint8_t*>(str.data());
+
+    // deltas of the second and the third byte of a character starting at i, stored at i + 2
+    auto seconds = std::vector<uint8_t>(size + 2);
+    auto thirds  = std::vector<uint8_t>(size + 2);
+    for(auto i = 0uz; i + 2 < size; i += 1) {
+        const auto tail  = uint16_t(bytes[i + 1] << 8 | bytes[i + 2]);
+        const auto hit   = uint8_t((bytes[i] == 0xe3) & (ranges[0].contains(tail) | ranges[1].contains(tail)));
+        const auto carry = uint8_t(((bytes[i + 2] >> 5) & 1) ^ !forward);
+        seconds[i + 2]   = hit * (1 + carry);
+        thirds[i + 2]    = hit * uint8_t(0x20 - (carry << 6));
+    }
+
+    auto result = std::string(size, '\0');
+    auto out    = reinterpret_cast<uint8_t*>(result.data());
+    for(auto i = 0uz; i < size; i += 1) {
+        const auto delta = uint8_t(seconds[i + 1] + thirds[i]);
+        out[i]           = forward ? bytes[i] + delta : bytes[i] - delta;
+    }
+    return result;
+}
+
+struct HalfKatakana {
+    char32_t    kana;
+    const char* half;
+};
+
+constexpr HalfKatakana half_katakana_pairs[] = {
+#include "half-katakana-table.txt"
+};
+
+// directly indexed by the code point, from U+3000
+constexpr auto half_katakana_table = [] {
+    auto table = std::array<const char*, 0x100>();
+    for(const auto& pair : half_katakana_pairs) {
+        table[pair.kana - 0x3000] = pair.half;
+    }
+    return table;
+}();
+} // namespace
+
+auto to_katakana(const std::string_view str) -> std::string {
+    return shift_kana<true>(str, hiragana_ranges);
+}
+
+auto to_hiragana(const std::string_view str) -> std::string {
+    return shift_kana<false>(str, katakana_ranges);
+}
+
+auto to_half_katakana(const std::string_view str) -> std::string {
+    const auto katakana = to_katakana(str);
+    auto       result   = std::string();
+    result.reserve(katakana.size());
+    for(auto pos = 0uz; pos < katakana.size();) {
+        const auto next = utf8::next(katakana, pos);
+        const auto code = utf8::decode(katakana, pos);
+        const auto half = code - 0x3000 < half_katakana_table.size() ? half_katakana_table[code - 0x3000] : nullptr;
+        if(half != nullptr) {
+            result += half;
+        } else {
+            result.append(katakana, pos, next - pos);
+        }
+        pos = next;
+    }
+    return result;
+}
+
+auto to_full_ascii(const std::string_view str) -> std::string {
+    auto result = std::string();
+    result.reserve(str.size() * 3);
+    for(const auto c : str) {
+        const auto byte = uint8_t(c);
+        if(byte == ' ') {
+            result += "　";
+        } else if(byte > ' ' && byte < 0x7f) {
+            // U+FF01-FF5E, ef bc 81-bf for 0x21-0x5f and ef bd 80-9e for 0x60-0x7e
+            const auto high   = uint8_t(byte >= 0x60);
+            const char full[] = {char(0xef), char(0xbc + high), char(byte + 0x60 - (high << 6))};
+            result.append(full, sizeof(full));
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+} // namespace mikan::kana
@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+namespace mikan::kana {
+// script conversions on utf-8 text, characters without a counterpart are kept as they are
+auto to_katakana(std::string_view str) -> std::string;
+auto to_hiragana(std::string_view str) -> std::string;
+// both hiragana and katakana are converted
+auto to_half_katakana(std::string_view str) -> std::string;
+// printable ascii and space to their full-width forms
+auto to_full_ascii(std::string_view str) -> std::string;
+} // namespace mikan::kana
@@ -5,6 +5,24 @@
 #include "mecab-model.hpp"
 
 namespace mikan {
+auto MeCabModel::LatticeReleaser::operator()(MeCab::Lattice* const lattice) const -> void {
+    lattice->clear();
+    auto guard = std::lock_guard(model->lattice_pool_lock);
+    model->lattice_pool.emplace_back(lattice);
+}
+
+auto MeCabModel::acquire_lattice() -> PooledLattice {
+    {
+        auto guard = std::lock_guard(lattice_pool_lock);
+        if(!lattice_pool.empty()) {
+            auto lattice = std::move(lattice_pool.back());
+            lattice_pool.pop_back();
+            return PooledLattice(lattice.release(), LatticeReleaser{this});
+        }
+    }
+    return PooledLattice(model->createLattice(), LatticeReleaser{this});
+}
+
 MeCabModel::MeCabModel(const char* const dictionary, const char* const user_dictionary, const bool is_system_dictionary)
     : is_valid(true),
       is_system_dictionary(is_system_dictionary) {
@@ -16,6 +34,37 @@ MeCabModel::MeCabModel(const char* const dictionary, const char* const user_dict
     model.reset(MeCab::createModel(dict_path.data()));
     ASSERT(model != nullptr, "failed to load system dictionary");
     tagger.reset(model->createTagger());
-    lattice.reset(model->createLattice());
 }
+
+auto LazyMeCabModel::acquire() -> std::pair<std::shared_ptr<MeCabModel>, bool> {
+    auto guard = std::lock_guard(lock);
+    last_used  = Clock::now();
+    if(model || failed) {
+        return {model, false};
+    }
+    try {
+        model = std::make_shared<MeCabModel>(path.data(), nullptr, false);
+    } catch(const std::runtime_error&) {
+        failed = true;
+        WARN("failed to load additional dictionary {}", path);
+        return {nullptr, false};
+    }
+    return {model, true};
+}
+
+auto LazyMeCabModel::unload_if_idle(const std::chrono::milliseconds timeout) -> std::optional<std::chrono::milliseconds> {
+    auto guard = std::lock_guard(lock);
+    if(!model) {
+        return std::nullopt;
+    }
+    const auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - last_used);
+    if(idle < timeout) {
+        return timeout - idle;
+    }
+    model.reset();
+    return std::nullopt;
+}
+
+LazyMeCabModel::LazyMeCabModel(std::string path)
+    : path(std::move(path)) {}
 } // namespace mikan
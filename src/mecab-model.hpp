@@ -1,17 +1,55 @@
 #pragma once
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include <mecab.h>
 
 namespace mikan {
 struct MeCabModel {
-    const bool                      is_valid             = false;
-    const bool                      is_system_dictionary = false;
-    std::unique_ptr<MeCab::Model>   model;
-    std::unique_ptr<MeCab::Tagger>  tagger;
-    std::unique_ptr<MeCab::Lattice> lattice;
+    struct LatticeReleaser {
+        MeCabModel* model;
+
+        auto operator()(MeCab::Lattice* lattice) const -> void;
+    };
+    // returned to the pool on destruction, must not outlive the model
+    using PooledLattice = std::unique_ptr<MeCab::Lattice, LatticeReleaser>;
+
+    const bool                     is_valid             = false;
+    const bool                     is_system_dictionary = false;
+    std::unique_ptr<MeCab::Model>  model;
+    std::unique_ptr<MeCab::Tagger> tagger; // parse(Lattice*) can be called from multiple threads
+
+    std::mutex                                   lattice_pool_lock;
+    std::vector<std::unique_ptr<MeCab::Lattice>> lattice_pool;
+
+    auto acquire_lattice() -> PooledLattice;
 
     MeCabModel() = default;
     MeCabModel(const char* dictionary, const char* user_dictionary, bool is_system_dictionary);
 };
+
+// a dictionary loaded on the first use, and unloaded when it is not used for a while
+// users keep the model alive by holding the returned pointer
+class LazyMeCabModel {
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    std::string                 path;
+    std::mutex                  lock;
+    std::shared_ptr<MeCabModel> model;
+    Clock::time_point           last_used;
+    bool                        failed = false; // do not try loading a broken dictionary again
+
+  public:
+    // returns the model, and whether it was loaded by this call. null on failure
+    auto acquire() -> std::pair<std::shared_ptr<MeCabModel>, bool>;
+    // returns the time left until it becomes idle, or nullopt if unloaded
+    auto unload_if_idle(std::chrono::milliseconds timeout) -> std::optional<std::chrono::milliseconds>;
+
+    LazyMeCabModel(std::string path);
+};
 } // namespace mikan
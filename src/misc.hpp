@@ -8,13 +8,8 @@
 namespace mikan {
 auto get_user_config_dir() -> std::string;
 auto get_user_cache_dir() -> std::string;
-auto get_dictionary_compiler_path() -> std::optional<std::string>;
-auto u8tou32(std::string_view u8) -> std::u32string;
-auto u32tou8(std::u32string_view u32) -> std::string;
-auto u32tou8(char32_t u32) -> std::string;
-auto kana_to_romaji(std::string_view kana) -> std::optional<std::string>;
-auto pop_back_u8(std::string& u8) -> char32_t;
 auto press_event_to_single_char(const fcitx::KeyEvent& event) -> std::optional<char>;
+auto fnv1a(std::string_view data, uint64_t hash = 0xcbf29ce484222325) -> uint64_t;
 
 template <typename T, typename E>
 auto contains(const T& vec, const E& elm) -> bool {
@@ -0,0 +1,81 @@
+#include <algorithm>
+
+#include "overlay-lexicon.hpp"
+
+namespace mikan {
+namespace {
+struct EntryLess {
+    auto operator()(const OverlayLexicon::Entry& a, const std::string_view b) const -> bool {
+        return a.raw < b;
+    }
+
+    auto operator()(const std::string_view a, const OverlayLexicon::Entry& b) const -> bool {
+        return a < b.raw;
+    }
+};
+} // namespace
+
+auto OverlayLexicon::rebuild_max_raw_length() -> void {
+    max_raw_length = 0;
+    for(const auto& entry : entries) {
+        max_raw_length = std::max(max_raw_length, entry.raw.size());
+    }
+}
+
+auto OverlayLexicon::empty() const -> bool {
+    return entries.empty();
+}
+
+auto OverlayLexicon::get_last_serial() const -> size_t {
+    return last_serial;
+}
+
+auto OverlayLexicon::get_max_raw_length() const -> size_t {
+    return max_raw_length;
+}
+
+auto OverlayLexicon::get_entries() const -> std::span<const Entry> {
+    return entries;
+}
+
+auto OverlayLexicon::find(const std::string_view raw) const -> std::span<const Entry> {
+    const auto [first, last] = std::equal_range(entries.begin(), entries.end(), raw, EntryLess());
+    return {first, last};
+}
+
+auto OverlayLexicon::common_prefix_search(const std::string_view str, const std::function<void(const Entry&)>& callback) const -> void {
+    const auto limit = std::min(max_raw_length, str.size());
+    for(auto length = 1uz; length <= limit; length += 1) {
+        if(length < str.size() && (uint8_t(str[length]) & 0xc0) == 0x80) {
+            // not a character boundary
+            continue;
+        }
+        for(const auto& entry : find(str.substr(0, length))) {
+            callback(entry);
+        }
+    }
+}
+
+auto OverlayLexicon::inserted(std::string raw, std::string converted) const -> OverlayLexicon {
+    auto ret = *this;
+    ret.last_serial += 1;
+    const auto pos = std::upper_bound(ret.entries.begin(), ret.entries.end(), raw, EntryLess());
+    ret.max_raw_length = std::max(ret.max_raw_length, raw.size());
+    ret.entries.insert(pos, Entry{std::move(raw), std::move(converted), ret.last_serial});
+    return ret;
+}
+
+auto OverlayLexicon::erased(const std::string_view raw) const -> OverlayLexicon {
+    auto ret = *this;
+    std::erase_if(ret.entries, [raw](const Entry& entry) { return entry.raw == raw; });
+    ret.rebuild_max_raw_length();
+    return ret;
+}
+
+auto OverlayLexicon::compacted(const size_t serial) const -> OverlayLexicon {
+    auto ret = *this;
+    std::erase_if(ret.entries, [serial](const Entry& entry) { return entry.serial <= serial; });
+    ret.rebuild_max_raw_length();
+    return ret;
+}
+} // namespace mikan
@@ -0,0 +1,40 @@
+#pragma once
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace mikan {
+// definitions added after the user dictionary was compiled.
+// looked up together with the mecab model until the next compilation.
+// immutable once published, modifications return a new lexicon.
+class OverlayLexicon {
+  public:
+    struct Entry {
+        std::string raw;
+        std::string converted;
+        size_t      serial; // increases with each insertion
+    };
+
+  private:
+    std::vector<Entry> entries; // sorted by raw, then by serial
+    size_t             max_raw_length = 0;
+    size_t             last_serial    = 0;
+
+    auto rebuild_max_raw_length() -> void;
+
+  public:
+    auto empty() const -> bool;
+    auto get_last_serial() const -> size_t;
+    auto get_max_raw_length() const -> size_t;
+    auto get_entries() const -> std::span<const Entry>;
+    auto find(std::string_view raw) const -> std::span<const Entry>;
+    // calls callback for each entry whose raw is a prefix of str, shorter first
+    auto common_prefix_search(std::string_view str, const std::function<void(const Entry&)>& callback) const -> void;
+
+    auto inserted(std::string raw, std::string converted) const -> OverlayLexicon;
+    auto erased(std::string_view raw) const -> OverlayLexicon;
+    // removes entries up to the serial, which are compiled into the user dictionary
+    auto compacted(size_t serial) const -> OverlayLexicon;
+};
+} // namespace mikan
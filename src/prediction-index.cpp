@@ -0,0 +1,109 @@
+#include <algorithm>
+
+#include "prediction-index.hpp"
+
+namespace mikan::engine {
+auto PredictionIndex::raw_of(const Entry& entry) const -> std::string_view {
+    return std::string_view(pool).substr(entry.raw, entry.raw_size);
+}
+
+auto PredictionIndex::converted_of(const Entry& entry) const -> std::string_view {
+    return std::string_view(pool).substr(entry.converted, entry.converted_size);
+}
+
+auto PredictionIndex::add(const std::string_view raw, const std::string_view converted, const uint32_t weight) -> void {
+    const auto offset = uint32_t(pool.size());
+    pool += raw;
+    pool += converted;
+    entries.emplace_back(Entry{offset, uint32_t(raw.size()), uint32_t(offset + raw.size()), uint32_t(converted.size()), weight});
+}
+
+auto PredictionIndex::finish() -> void {
+    const auto key = [this](const Entry& entry) { return std::pair(raw_of(entry), converted_of(entry)); };
+    std::ranges::sort(entries, [&key](const Entry& a, const Entry& b) {
+        const auto ka = key(a);
+        const auto kb = key(b);
+        return ka != kb ? ka < kb : a.weight > b.weight;
+    });
+    // the first one of the duplicates has the highest weight
+    const auto [first, last] = std::ranges::unique(entries, {}, key);
+    entries.erase(first, last);
+    entries.shrink_to_fit();
+
+    // leaves at [size, size * 2), and the parent of i at i / 2
+    const auto size = entries.size();
+    tree.resize(size * 2);
+    for(auto i = 0uz; i < size; i += 1) {
+        tree[size + i] = uint32_t(i);
+    }
+    for(auto i = size; i > 1; i -= 1) {
+        const auto a = tree[(i - 1) * 2];
+        const auto b = tree[(i - 1) * 2 + 1];
+        tree[i - 1]  = is_better(b, a) ? b : a;
+    }
+}
+
+auto PredictionIndex::is_better(const uint32_t a, const uint32_t b) const -> bool {
+    const auto& ea = entries[a];
+    const auto& eb = entries[b];
+    return ea.weight != eb.weight ? ea.weight > eb.weight : ea.raw_size != eb.raw_size ? ea.raw_size < eb.raw_size
+                                                                                       : a < b;
+}
+
+auto PredictionIndex::find_best(size_t first, size_t last) const -> uint32_t {
+    const auto size = entries.size();
+    auto       best = uint32_t(first);
+    for(first += size, last += size; first < last; first /= 2, last /= 2) {
+        if(first % 2 == 1) {
+            best = is_better(tree[first], best) ? tree[first] : best;
+            first += 1;
+        }
+        if(last % 2 == 1) {
+            last -= 1;
+            best = is_better(tree[last], best) ? tree[last] : best;
+        }
+    }
+    return best;
+}
+
+auto PredictionIndex::size() const -> size_t {
+    return entries.size();
+}
+
+auto PredictionIndex::search(const std::string_view prefix, const size_t limit) const -> std::vector<Prediction> {
+    // the entries starting with prefix are contiguous
+    const auto head  = [this, &prefix](const Entry& entry) { return raw_of(entry).substr(0, prefix.size()); };
+    const auto begin = std::ranges::lower_bound(entries, prefix, {}, head);
+    const auto end   = std::ranges::upper_bound(begin, entries.end(), prefix, {}, head);
+
+    // take the best of a range, then split the range at it, without visiting the whole of it
+    struct Range {
+        uint32_t best;
+        size_t   first;
+        size_t   last;
+    };
+    const auto worse = [this](const Range& a, const Range& b) { return is_better(b.best, a.best); };
+
+    auto ranges = std::vector<Range>();
+    auto push   = [this, &ranges, &worse](const size_t first, const size_t last) {
+        if(first < last) {
+            ranges.emplace_back(Range{find_best(first, last), first, last});
+            std::ranges::push_heap(ranges, worse);
+        }
+    };
+    push(size_t(begin - entries.begin()), size_t(end - entries.begin()));
+
+    auto result = std::vector<Prediction>();
+    result.reserve(std::min(limit, size_t(end - begin)));
+    while(!ranges.empty() && result.size() < limit) {
+        std::ranges::pop_heap(ranges, worse);
+        const auto range = ranges.back();
+        ranges.pop_back();
+        const auto& entry = entries[range.best];
+        result.emplace_back(Prediction{raw_of(entry), converted_of(entry), entry.weight});
+        push(range.first, range.best);
+        push(range.best + 1, range.last);
+    }
+    return result;
+}
+} // namespace mikan::engine
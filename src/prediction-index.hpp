@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mikan::engine {
+// readings and their conversions in a sorted array, searched by prefix for predictive completion.
+// filled with add(), then made searchable with finish()
+class PredictionIndex {
+  public:
+    struct Prediction {
+        std::string_view raw;
+        std::string_view converted;
+        uint32_t         weight;
+    };
+
+  private:
+    struct Entry {
+        uint32_t raw; // offset in pool
+        uint32_t raw_size;
+        uint32_t converted; // offset in pool
+        uint32_t converted_size;
+        uint32_t weight;
+    };
+
+    std::string           pool;
+    std::vector<Entry>    entries; // sorted by raw, then by converted
+    std::vector<uint32_t> tree;    // segment tree over entries, holding the index of the best entry of each node
+
+    auto raw_of(const Entry& entry) const -> std::string_view;
+    auto converted_of(const Entry& entry) const -> std::string_view;
+    // higher weight first, then shorter reading first
+    auto is_better(uint32_t a, uint32_t b) const -> bool;
+    // index of the best entry in [first, last)
+    auto find_best(size_t first, size_t last) const -> uint32_t;
+
+  public:
+    auto add(std::string_view raw, std::string_view converted, uint32_t weight) -> void;
+    // sorts the entries and merges the duplicates, keeping the highest weight
+    auto finish() -> void;
+    auto size() const -> size_t;
+    // entries whose reading starts with prefix, highest weight first, then shorter reading first.
+    // takes O(limit * log(size)) regardless of the number of matches. valid while the index is alive
+    auto search(std::string_view prefix, size_t limit) const -> std::vector<Prediction>;
+};
+} // namespace mikan::engine
@@ -1,81 +1,232 @@
+#include <array>
+#include <optional>
+
 #include "romaji-index.hpp"
 
 namespace mikan {
-auto RomajiIndex::search_by_nth_chara(const char chara, const size_t n, const RomajiKana** const exact) const -> std::vector<size_t> {
-    auto r = std::vector<size_t>();
-    if(n == 0) {
-        for(auto i = std::begin(romaji_table); i < std::end(romaji_table); i += 1) {
-            const auto& romaji = i->romaji;
-            if(romaji[0] == chara) {
-                if(romaji.size() == n + 1) {
-                    *exact = i;
-                    return r;
-                }
-                r.emplace_back(i - std::begin(romaji_table));
+namespace {
+constexpr auto length_of(const char* const str) -> size_t {
+    auto len = 0uz;
+    while(str[len] != '\0') {
+        len += 1;
+    }
+    return len;
+}
+
+// characters appearing in the table, numbered from 1. 0 is for the others
+struct CharClasses {
+    std::array<uint8_t, 128> of    = {};
+    size_t                   count = 1;
+};
+
+constexpr auto char_classes = [] {
+    auto classes = CharClasses();
+    for(const auto& entry : romaji_table) {
+        for(auto p = entry.romaji; *p != '\0'; p += 1) {
+            auto& c = classes.of[uint8_t(*p)];
+            if(c == 0) {
+                c = classes.count;
+                classes.count += 1;
             }
         }
-    } else {
-        for(const auto i : cache) {
-            const auto& romaji = romaji_table[i].romaji;
-            if(romaji.size() <= n) {
-                continue;
+    }
+    return classes;
+}();
+
+// a state is the typed prefix of some entries.
+// a transition either leads to another state, or completes an entry with exact_flag set.
+// an entry completes as soon as it is typed, even if longer entries start with it, and the first one in the table wins.
+constexpr auto dead_state = uint16_t(0);
+constexpr auto root_state = uint16_t(1);
+constexpr auto exact_flag = uint16_t(0x8000);
+
+template <size_t states>
+struct Automaton {
+    std::array<std::array<uint16_t, char_classes.count>, states> next      = {};
+    std::array<uint16_t, states>                                 remaining = {}; // number of entries reachable from the state
+    std::array<uint16_t, states>                                 last      = {}; // one of them, the only one if remaining is 1
+    size_t                                                       count     = 2;  // dead and root
+};
+
+constexpr auto max_states = [] {
+    auto count = 2uz;
+    for(const auto& entry : romaji_table) {
+        count += length_of(entry.romaji);
+    }
+    return count;
+}();
+
+template <size_t states>
+constexpr auto build_automaton() -> Automaton<states> {
+    static_assert(std::size(romaji_table) < exact_flag);
+    auto automaton = Automaton<states>();
+    for(auto i = uint16_t(0); i < std::size(romaji_table); i += 1) {
+        const auto romaji = romaji_table[i].romaji;
+        const auto length = length_of(romaji);
+        auto       state  = root_state;
+        for(auto n = 0uz; n < length; n += 1) {
+            auto& next = automaton.next[state][char_classes.of[uint8_t(romaji[n])]];
+            if(next & exact_flag) {
+                break; // shadowed by an earlier entry
+            }
+            if(n + 1 == length) {
+                next = exact_flag | i;
+                break;
             }
-            if(romaji[n] == chara) {
-                if(romaji.size() == n + 1) {
-                    *exact = &romaji_table[i];
-                    return r;
-                }
-                r.emplace_back(i);
+            if(next == dead_state) {
+                next = automaton.count;
+                automaton.count += 1;
             }
+            state = next;
+            automaton.remaining[state] += 1;
+            automaton.last[state] = i;
         }
     }
-    return r;
+    return automaton;
 }
 
-auto RomajiIndex::filter(const std::string_view to_kana) -> FilterResult {
-    if(to_kana.empty()) {
-        return FilterResult::create<InvalidParam>();
+// built twice, to count the states first
+constexpr auto automaton = build_automaton<build_automaton<max_states>().count>();
+
+// the code point of a string of a single character, 0 otherwise
+constexpr auto decode_single(const char* const str) -> char32_t {
+    const auto lead   = uint8_t(str[0]);
+    const auto length = lead < 0x80 ? 1uz : lead >= 0xf0 ? 4uz
+                                        : lead >= 0xe0   ? 3uz
+                                        : lead >= 0xc0   ? 2uz
+                                                         : 0uz;
+    if(length == 0 || length_of(str) != length) {
+        return 0;
     }
+    auto code = length == 1 ? char32_t(lead) : char32_t(lead & (0xff >> (length + 1)));
+    for(auto i = 1uz; i < length; i += 1) {
+        code = code << 6 | (uint8_t(str[i]) & 0x3f);
+    }
+    return code;
+}
 
-    auto use_cache = true;
-    if(!cache_source.empty() && to_kana.size() == cache_source.size() + 1) {
-        for(auto i = 0uz; i < cache_source.size(); i += 1) {
-            if(cache_source[i] != to_kana[i]) {
-                use_cache = false;
-                break;
-            }
-        }
+// the first entry producing each character, directly indexed by the code point.
+// covers ascii and the cjk symbols and punctuation, hiragana and katakana blocks
+constexpr auto kana_block_begin = char32_t(0x3000);
+
+constexpr auto reverse_slot_of(const char32_t code) -> std::optional<size_t> {
+    if(code < 0x80) {
+        return code;
+    } else if(code - kana_block_begin < 0x100) {
+        return 0x80 + (code - kana_block_begin);
     } else {
-        use_cache = false;
+        return std::nullopt;
     }
+}
+
+struct ReverseTable {
+    std::array<uint16_t, 0x180> slots    = {}; // index in romaji_table + 1, 0 if none
+    bool                        complete = true;
+};
 
-    auto exact = (const RomajiKana*)nullptr;
-    if(!use_cache) {
-        cache.clear();
-        for(auto i = 0uz; i < to_kana.size(); i += 1) {
-            cache = search_by_nth_chara(to_kana[i], i, &exact);
-            if(exact != nullptr) {
-                goto end;
+constexpr auto reverse_table = [] {
+    auto table = ReverseTable();
+    for(auto i = 0uz; i < std::size(romaji_table); i += 1) {
+        const auto code = decode_single(romaji_table[i].kana);
+        if(code == 0) {
+            continue; // not a single character, such as "きゃ"
+        }
+        if(const auto slot = reverse_slot_of(code); !slot) {
+            table.complete = false;
+        } else if(table.slots[*slot] == 0) {
+            table.slots[*slot] = i + 1;
+        }
+    }
+    return table;
+}();
+static_assert(reverse_table.complete, "romaji_table has a character out of the reverse table range");
+} // namespace
+
+auto kana_to_romaji(const char32_t kana) -> std::optional<std::string_view> {
+    const auto slot = reverse_slot_of(kana);
+    if(!slot || reverse_table.slots[*slot] == 0) {
+        return std::nullopt;
+    }
+    return romaji_table[reverse_table.slots[*slot] - 1].romaji;
+}
+
+auto kana_to_romaji(const std::string_view kana) -> std::string {
+    constexpr auto sokuon = std::string_view("っ");
+
+    auto result  = std::string();
+    auto pending = 0uz; // number of "っ" waiting for the next romaji
+    // "っ" is written as the consonant of the next romaji, or on its own before a vowel or a character without romaji
+    const auto flush = [&](const std::string_view next) {
+        const auto doubled = !next.empty() && next[0] >= 'a' && next[0] <= 'z' && !std::string_view("aiueon").contains(next[0]);
+        for(; pending > 0; pending -= 1) {
+            if(doubled) {
+                result += next[0];
+            } else {
+                result += *kana_to_romaji(U'っ');
             }
         }
-    } else {
-        exact = (const RomajiKana*)nullptr;
-        cache = search_by_nth_chara(to_kana.back(), to_kana.size() - 1, &exact);
-        if(exact != nullptr) {
-            goto end;
+    };
+
+    auto pos = 0uz;
+    while(pos < kana.size()) {
+        const auto rest  = kana.substr(pos);
+        auto       match = (const RomajiKana*)nullptr;
+        for(const auto& entry : romaji_table) {
+            if(entry.refill == nullptr && rest.starts_with(entry.kana) && (match == nullptr || length_of(entry.kana) > length_of(match->kana))) {
+                match = &entry;
+            }
+        }
+        if(match == nullptr) {
+            auto next = pos + 1;
+            while(next < kana.size() && (uint8_t(kana[next]) & 0xc0) == 0x80) {
+                next += 1;
+            }
+            flush({});
+            result.append(kana, pos, next - pos);
+            pos = next;
+            continue;
+        }
+        pos += length_of(match->kana);
+        if(match->kana == sokuon) {
+            pending += 1;
+            continue;
         }
+        flush(match->romaji);
+        result += match->romaji;
     }
-    if(cache.size() == 0) {
-        return FilterResult::create<EmptyCache>();
+    flush({});
+    return result;
+}
+
+auto RomajiIndex::filter(const std::string_view to_kana) -> FilterResult {
+    if(to_kana.empty()) {
+        return FilterResult::create<InvalidParam>();
     }
-    if(cache.size() == 1) {
-        exact = &romaji_table[cache[0]];
+
+    // continue from the last call if only one character was appended
+    auto state = root_state;
+    auto pos   = 0uz;
+    if(!cache_source.empty() && to_kana.size() == cache_source.size() + 1 && to_kana.starts_with(cache_source)) {
+        state = cache_state;
+        pos   = cache_source.size();
     }
-end:
-    if(exact != nullptr) {
-        cache_source.clear();
-        return FilterResult::create<ExactOne>(exact);
-    } else {
+    cache_source.clear();
+
+    for(; pos < to_kana.size() && state != dead_state; pos += 1) {
+        const auto c = uint8_t(to_kana[pos]);
+        state        = automaton.next[state][c < char_classes.of.size() ? char_classes.of[c] : 0];
+        if(state & exact_flag) {
+            return FilterResult::create<ExactOne>(&romaji_table[state & ~exact_flag]);
+        }
+    }
+
+    switch(automaton.remaining[state]) {
+    case 0:
+        return FilterResult::create<EmptyCache>();
+    case 1:
+        return FilterResult::create<ExactOne>(&romaji_table[automaton.last[state]]);
+    default:
+        cache_state  = state;
         cache_source = to_kana;
         return FilterResult::create<MultiResult>();
     }
@@ -1,17 +1,16 @@
 #pragma once
+#include <optional>
 #include <string>
-#include <vector>
 
 #include "romaji-table.hpp"
 #include "util/variant.hpp"
 
 namespace mikan {
+// matches typed romaji against romaji_table with an automaton built at compile time
 struct RomajiIndex {
   private:
-    std::vector<size_t> cache;
-    std::string         cache_source;
-
-    auto search_by_nth_chara(char chara, size_t n, const RomajiKana** exact) const -> std::vector<size_t>;
+    uint16_t    cache_state = 0; // state after cache_source
+    std::string cache_source;
 
   public:
     struct MultiResult {};
@@ -24,4 +23,10 @@ struct RomajiIndex {
 
     auto filter(std::string_view to_kana) -> FilterResult;
 };
+
+// the romaji which produces the character, for taking back the last character typed
+auto kana_to_romaji(char32_t kana) -> std::optional<std::string_view>;
+// romaji which types the hiragana text, preferring the longest kana of an entry and doubling consonants for "っ".
+// characters which cannot be typed are kept as they are
+auto kana_to_romaji(std::string_view kana) -> std::string;
 } // namespace mikan
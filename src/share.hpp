@@ -1,8 +1,11 @@
 #pragma once
+#include <atomic>
+
 #include <fcitx/instance.h>
 
 #include "configuration.hpp"
 #include "mecab-model.hpp"
+#include "overlay-lexicon.hpp"
 
 namespace mikan {
 enum class InsertSpaceOptions {
@@ -13,14 +16,24 @@ enum class InsertSpaceOptions {
 };
 
 struct Share {
-    fcitx::Instance*                         instance                = nullptr;
-    fcitx::AddonInstance*                    clipboard               = nullptr;
-    size_t                                   auto_commit_threshold   = 8;
-    std::string                              dictionary_path         = "/usr/share/mikan-im/dic";
-    int                                      candidate_page_size     = 10;
-    InsertSpaceOptions                       insert_space            = InsertSpaceOptions::Smart;
-    std::vector<std::unique_ptr<MeCabModel>> additional_vocabularies = {};
-    std::shared_ptr<MeCabModel>              primary_vocabulary      = {};
-    KeyConfig                                key_config              = {};
+    fcitx::Instance*                                   instance                = nullptr;
+    fcitx::AddonInstance*                              clipboard               = nullptr;
+    size_t                                             auto_commit_threshold   = 8;
+    size_t                                             n_best_limit            = 100;
+    size_t                                             conversion_cache_size   = 512;
+    size_t                                             conversion_cache_memory = 4 * 1024 * 1024;
+    size_t                                             background_delay        = 100; // ms
+    size_t                                             prefetch_budget         = 30;  // ms
+    size_t                                             prefetch_neighbours     = 1;
+    std::string                                        dictionary_path         = "/usr/share/mikan-im/dic";
+    int                                                candidate_page_size     = 10;
+    InsertSpaceOptions                                 insert_space            = InsertSpaceOptions::Smart;
+    size_t                                             history_size            = 8192; // slots, 0 to disable learning
+    bool                                               vocabulary_warmup       = true;
+    size_t                                             vocabulary_idle_timeout = 600; // s, 0 to keep loaded
+    std::vector<std::unique_ptr<LazyMeCabModel>>       additional_vocabularies = {};
+    std::atomic<std::shared_ptr<MeCabModel>>           primary_vocabulary      = {};
+    std::atomic<std::shared_ptr<const OverlayLexicon>> overlay_lexicon         = std::make_shared<const OverlayLexicon>();
+    KeyConfig                                          key_config              = {};
 };
 } // namespace mikan
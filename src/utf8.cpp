@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "utf8.hpp"
+
+namespace mikan::utf8 {
+namespace {
+// the strings are processed a word at a time where possible
+constexpr auto high_bits = uint64_t(0x8080808080808080);
+
+auto load_word(const char* const ptr) -> uint64_t {
+    auto word = uint64_t();
+    std::memcpy(&word, ptr, sizeof(word));
+    return word;
+}
+
+auto is_continuation(const char c) -> bool {
+    return (uint8_t(c) & 0xc0) == 0x80;
+}
+} // namespace
+
+auto validate(const std::string_view str) -> bool {
+    const auto bytes = reinterpret_cast<const uint8_t*>(str.data());
+    const auto size  = str.size();
+    for(auto i = 0uz; i < size;) {
+        // skip ascii runs
+        if(i + sizeof(uint64_t) <= size && (load_word(str.data() + i) & high_bits) == 0) {
+            i += sizeof(uint64_t);
+            continue;
+        }
+        const auto lead = bytes[i];
+        if(lead < 0x80) {
+            i += 1;
+            continue;
+        }
+        // the range of the second byte excludes overlong forms, surrogates and code points over U+10FFFF
+        auto length = 0uz;
+        auto min    = uint8_t(0x80);
+        auto max    = uint8_t(0xbf);
+        if(lead >= 0xc2 && lead <= 0xdf) {
+            length = 2;
+        } else if(lead >= 0xe0 && lead <= 0xef) {
+            length = 3;
+            min    = lead == 0xe0 ? 0xa0 : min;
+            max    = lead == 0xed ? 0x9f : max;
+        } else if(lead >= 0xf0 && lead <= 0xf4) {
+            length = 4;
+            min    = lead == 0xf0 ? 0x90 : min;
+            max    = lead == 0xf4 ? 0x8f : max;
+        } else {
+            return false;
+        }
+        if(i + length > size || bytes[i + 1] < min || bytes[i + 1] > max) {
+            return false;
+        }
+        for(auto j = 2uz; j < length; j += 1) {
+            if(!is_continuation(str[i + j])) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+auto next(const std::string_view str, size_t pos) -> size_t {
+    // a stray continuation byte is a character by itself
+    const auto end = is_continuation(str[pos]) ? pos + 1 : std::min(str.size(), pos + 4);
+    pos += 1;
+    while(pos < end && is_continuation(str[pos])) {
+        pos += 1;
+    }
+    return pos;
+}
+
+auto prev(const std::string_view str, const size_t pos) -> size_t {
+    // the lead byte is within 3 continuation bytes, a longer run is invalid and stepped back by a byte
+    for(auto i = 1uz; i <= 4 && i <= pos; i += 1) {
+        if(!is_continuation(str[pos - i])) {
+            return pos - i;
+        }
+    }
+    return pos == 0 ? 0 : pos - 1;
+}
+
+auto decode(const std::string_view str, const size_t pos) -> char32_t {
+    const auto lead = uint8_t(str[pos]);
+    if(lead < 0x80 && (pos + 1 == str.size() || !is_continuation(str[pos + 1]))) {
+        return lead;
+    }
+    // a lead byte and its continuation bytes, which is a single character if valid
+    const auto character = str.substr(pos, next(str, pos) - pos);
+    if(character.size() == 1 || !validate(character)) {
+        return replacement;
+    }
+    auto code = char32_t(lead & (0xff >> (character.size() + 1)));
+    for(const auto c : character.substr(1)) {
+        code = code << 6 | (uint8_t(c) & 0x3f);
+    }
+    return code;
+}
+
+auto pop_back(std::string& str) -> char32_t {
+    if(str.empty()) {
+        return 0;
+    }
+    const auto pos  = prev(str, str.size());
+    const auto code = decode(str, pos);
+    str.resize(pos);
+    return code;
+}
+} // namespace mikan::utf8
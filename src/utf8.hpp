@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+
+namespace mikan::utf8 {
+// returned by decode() for invalid characters
+constexpr auto replacement = char32_t(0xfffd);
+
+auto validate(std::string_view str) -> bool;
+// a character is a lead byte and the continuation bytes after it, 3 at most, and each of the continuation bytes after those.
+// so invalid text is stepped through in the same characters in both directions.
+// byte offset of the next or the previous character of the one at pos
+auto next(std::string_view str, size_t pos) -> size_t;
+auto prev(std::string_view str, size_t pos) -> size_t;
+// the code point of the character at pos, replacement if it is truncated or otherwise invalid
+auto decode(std::string_view str, size_t pos) -> char32_t;
+// removes the last character and returns it, 0 if str is empty
+auto pop_back(std::string& str) -> char32_t;
+} // namespace mikan::utf8
@@ -1,92 +1,141 @@
-#include "word.hpp"
+#include <algorithm>
+#include <future>
+
 #include "misc.hpp"
+#include "word.hpp"
 
 namespace mikan {
+namespace {
+auto lookup_dictionary(MeCabModel& dict, const std::string& raw) -> std::vector<std::string> {
+    auto  features    = std::vector<std::string>();
+    auto  lattice_ref = dict.acquire_lattice();
+    auto& lattice     = *lattice_ref;
+    lattice.set_request_type(MECAB_NBEST);
+    lattice.set_sentence(raw.data());
+    lattice.set_feature_constraint(0, raw.size(), "*");
+    dict.tagger->parse(&lattice);
+    do {
+        for(const auto* node = lattice.bos_node(); node; node = node->next) {
+            if(node->stat != MECAB_NOR_NODE) {
+                continue;
+            }
+            emplace_unique(features, std::string(node->feature));
+        }
+    } while(lattice.next());
+    return features;
+}
+} // namespace
+
 auto Word::get_data_size() const -> size_t {
-    if(candidates.size() > 2) {
-        return candidates.size() - 2;
+    if(!candidates.empty()) {
+        return candidates.size();
     } else {
         return 1;
     }
 }
 
-auto Word::get_labels() const -> std::vector<std::string> {
-    if(candidates.size() > 2) {
-        auto labels = std::vector<std::string>();
-        for(auto i = candidates.begin() + 2; i < candidates.end(); i += 1) {
-            labels.emplace_back(*i);
-        }
-        return labels;
+auto Word::get_labels(const size_t first) const -> std::vector<std::string> {
+    if(!candidates.empty()) {
+        return {candidates.begin() + std::min(first, candidates.size()), candidates.end()};
+    } else if(first == 0) {
+        return {std::string(feature())};
     } else {
-        return {feature()};
+        return {};
     }
 }
 
 auto Word::has_candidates() const -> bool {
-    return candidates.size() > 2;
+    return !candidates.empty();
 }
 
-auto Word::feature() -> std::string& {
-    if(candidates.size() > 2) {
-        return candidates[index + 2];
-    } else if(candidates.size() > 1) {
-        return candidates[1];
+auto Word::feature() const -> std::string_view {
+    if(!candidates.empty()) {
+        return candidates[index];
+    } else if(converted.data() != nullptr) {
+        return converted;
     } else {
-        return candidates[0];
+        return raw_text;
     }
 }
 
+auto Word::set_converted(std::string text) -> void {
+    const auto storage = std::make_shared<const std::string>(std::move(text));
+    converted          = *storage;
+    owner              = storage;
+}
+
 auto Word::raw() -> std::string& {
-    return candidates[0];
+    return raw_text;
 }
+
 auto Word::raw() const -> const std::string& {
-    return candidates[0];
+    return raw_text;
 }
 
-auto Word::feature() const -> const std::string& {
-    return ((Word*)this)->feature();
+auto Word::from_node(const MeCab::Node& node, std::shared_ptr<const void> owner) -> Word {
+    return from_node(std::string_view(node.surface, node.length), node.feature, node.stat == MECAB_UNK_NODE, std::move(owner));
 }
 
-auto Word::from_node(const MeCab::Node& node) -> Word {
-    auto word = Word();
-    word.candidates.emplace_back(std::string(node.surface, node.length));
-    if(node.stat != MECAB_UNK_NODE) {
-        word.candidates.emplace_back(node.feature);
+auto Word::from_node(const std::string_view surface, const char* const feature, const bool unknown, std::shared_ptr<const void> owner) -> Word {
+    auto word     = Word();
+    word.raw_text = surface;
+    if(!unknown) {
+        word.converted = feature;
+        word.owner     = std::move(owner);
     }
     return word;
 }
 
 auto Word::from_raw(std::string raw) -> Word {
-    auto word       = Word();
-    word.candidates = {std::move(raw)};
+    auto word     = Word();
+    word.raw_text = std::move(raw);
     return word;
 }
 
 auto Word::from_dictionaries(std::span<MeCabModel*> dicts, const Word& source) -> Word {
-    auto ret = Word();
-    ret.candidates.emplace_back(source.candidates[0]);
-    if(source.candidates.size() > 1) {
-        ret.candidates.emplace_back(source.candidates[1]);
+    auto ret      = Word();
+    ret.raw_text  = source.raw_text;
+    ret.converted = source.converted;
+    ret.owner     = source.owner;
+    if(dicts.empty()) {
+        return ret;
     }
 
-    const auto& raw = source.candidates[0];
-    for(const auto dict : dicts) {
-        auto& lattice = *dict->lattice;
-        lattice.set_request_type(MECAB_NBEST);
-        lattice.set_sentence(raw.data());
-        lattice.set_feature_constraint(0, raw.size(), "*");
-        dict->tagger->parse(&lattice);
-        do {
-            for(const auto* node = lattice.bos_node(); node; node = node->next) {
-                if(node->stat != MECAB_NOR_NODE) {
-                    continue;
-                }
-                emplace_unique(ret.candidates, std::string(node->feature));
-            }
-        } while(lattice.next());
-        lattice.clear();
+    // look up the dictionaries in parallel, then merge them in the given order
+    const auto& raw     = source.raw_text;
+    const auto  add     = [&ret](const std::string& feature) {
+        if(feature != ret.raw_text && feature != ret.converted) {
+            emplace_unique(ret.candidates, feature);
+        }
+    };
+    auto futures = std::vector<std::future<std::vector<std::string>>>();
+    for(const auto dict : dicts.subspan(1)) {
+        futures.emplace_back(std::async(std::launch::async, lookup_dictionary, std::ref(*dict), std::cref(raw)));
+    }
+    for(auto& feature : lookup_dictionary(*dicts[0], raw)) {
+        add(feature);
+    }
+    for(auto& future : futures) {
+        for(auto& feature : future.get()) {
+            add(feature);
+        }
     }
 
     return ret;
 }
+
+auto ChainOffsets::word_at(const size_t pos) const -> size_t {
+    // the last word beginning at or before pos, begins[0] is always 0
+    const auto it = std::upper_bound(begins.begin(), begins.end(), pos);
+    return size_t(it - begins.begin()) - 1;
+}
+
+auto ChainOffsets::from_chain(const WordChain& chain) -> ChainOffsets {
+    auto offsets = ChainOffsets();
+    offsets.begins.resize(chain.size() + 1);
+    for(auto i = 0uz; i < chain.size(); i += 1) {
+        offsets.begins[i + 1] = offsets.begins[i] + chain[i].raw().size();
+    }
+    return offsets;
+}
 } // namespace mikan
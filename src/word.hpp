@@ -1,4 +1,5 @@
 #pragma once
+#include <memory>
 #include <span>
 
 #include "candidates.hpp"
@@ -12,25 +13,46 @@ enum class ProtectionLevel {
 };
 
 struct Word : Candidates {
-    // candidates[0]: always present, raw hiragana
-    // candidates[1]: automatically converted text
-    // candidates[2]...: per-word candidates
+    // per-word candidates, empty until looked up
     std::vector<std::string> candidates;
     ProtectionLevel          protection = ProtectionLevel::None;
 
+  private:
+    std::string raw_text; // hiragana
+    // automatically converted text, null if not converted. always null-terminated.
+    // it usually points into the dictionary of a model, which owner keeps alive,
+    // so that words can be copied between conversions, caches and candidate lists without copying it.
+    std::string_view            converted;
+    std::shared_ptr<const void> owner;
+
+  public:
     auto get_data_size() const -> size_t override;
-    auto get_labels() const -> std::vector<std::string> override;
+    auto get_labels(size_t first) const -> std::vector<std::string> override;
     auto has_candidates() const -> bool;
     auto raw() -> std::string&;
     auto raw() const -> const std::string&;
-    auto feature() -> std::string&;
-    auto feature() const -> const std::string&;
+    // the selected candidate, the converted text, or raw, in this order. null-terminated.
+    auto feature() const -> std::string_view;
+    auto set_converted(std::string text) -> void;
 
-    static auto from_node(const MeCab::Node& node) -> Word;
+    // the feature is referenced while the owner is alive
+    static auto from_node(const MeCab::Node& node, std::shared_ptr<const void> owner) -> Word;
+    static auto from_node(std::string_view surface, const char* feature, bool unknown, std::shared_ptr<const void> owner) -> Word;
     static auto from_dictionaries(std::span<MeCabModel*> dicts, const Word& source) -> Word;
     static auto from_raw(std::string raw) -> Word;
 };
 
 using WordChain  = std::vector<Word>;
 using WordChains = std::vector<WordChain>;
+
+// cumulative byte offsets of the raw texts in a chain.
+// conversions keep the concatenated raw text, so positions can be carried over by byte offset.
+struct ChainOffsets {
+    std::vector<size_t> begins; // begins[i]: offset of chain[i], begins.back(): total size
+
+    // index of the word containing the byte, chain.size() if out of range
+    auto word_at(size_t pos) const -> size_t;
+
+    static auto from_chain(const WordChain& chain) -> ChainOffsets;
+};
 } // namespace mikan
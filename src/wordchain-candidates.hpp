@@ -1,10 +1,17 @@
 #pragma once
+#include <functional>
+
 #include "word.hpp"
 
 namespace mikan {
 class WordChainCandidates : public Candidates {
+  public:
+    // returns the next count chains at most, fewer only when exhausted
+    using Generator = std::function<WordChains(size_t count)>;
+
   private:
     WordChains data;
+    Generator  more;
 
   public:
     auto empty() const -> bool {
@@ -15,24 +22,52 @@ class WordChainCandidates : public Candidates {
         return data.size();
     }
 
-    auto get_labels() const -> std::vector<std::string> {
+    auto get_labels(const size_t first) const -> std::vector<std::string> override {
         auto labels = std::vector<std::string>();
-        for(auto& s : data) {
+        for(auto i = first; i < data.size(); i += 1) {
             auto& label = labels.emplace_back();
-            for(auto& p : s) {
+            for(auto& p : data[i]) {
                 label += p.feature();
             }
         }
         return labels;
     }
 
-    auto reset(WordChains&& n) -> void { // FIXME: as value
+    auto has_more() const -> bool override {
+        return bool(more);
+    }
+
+    auto load_more(const size_t size) -> void override {
+        if(!more || data.size() >= size) {
+            return;
+        }
+        const auto count  = size - data.size();
+        auto       chains = more(count);
+        if(chains.size() < count) {
+            more = nullptr;
+        }
+        std::ranges::move(chains, std::back_inserter(data));
+    }
+
+    auto reset(WordChains&& n, Generator generator = nullptr) -> void { // FIXME: as value
         data  = std::move(n);
+        more  = std::move(generator);
+        index = 0;
+    }
+
+    // same as reset({current chain}), without copying it
+    auto reset_to_current() -> void {
+        if(index != 0) {
+            data[0] = std::move(data[index]);
+        }
+        data.resize(1);
+        more  = nullptr;
         index = 0;
     }
 
     auto clear() -> void {
         data.clear();
+        more = nullptr;
     }
 
     auto operator[](const size_t index) -> WordChain& {
@@ -0,0 +1,51 @@
+#include "worker.hpp"
+#include "macros/assert.hpp"
+
+namespace mikan {
+auto Worker::run() -> void {
+    auto guard = std::unique_lock(lock);
+    while(!exiting) {
+        if(jobs.empty()) {
+            condition.wait(guard);
+            continue;
+        }
+        const auto next = std::ranges::min_element(jobs, {}, &Job::due);
+        if(next->due > Clock::now()) {
+            condition.wait_until(guard, next->due);
+            continue;
+        }
+        auto function = std::move(next->function);
+        jobs.erase(next);
+        guard.unlock();
+        // a failing job must not take the whole input method down
+        try {
+            function();
+        } catch(const std::exception& e) {
+            WARN("worker job failed: {}", e.what());
+        } catch(...) {
+            WARN("worker job failed");
+        }
+        guard.lock();
+    }
+}
+
+auto Worker::post(std::function<void()> function, const std::chrono::milliseconds delay) -> void {
+    {
+        auto guard = std::lock_guard(lock);
+        jobs.emplace_back(Job{Clock::now() + delay, std::move(function)});
+    }
+    condition.notify_one();
+}
+
+Worker::Worker()
+    : thread([this] { run(); }) {}
+
+Worker::~Worker() {
+    {
+        auto guard = std::lock_guard(lock);
+        exiting    = true;
+    }
+    condition.notify_one();
+    thread.join();
+}
+} // namespace mikan
@@ -0,0 +1,34 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mikan {
+// a background thread which runs posted jobs after their delay
+class Worker {
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        Clock::time_point     due;
+        std::function<void()> function;
+    };
+
+    std::mutex              lock;
+    std::condition_variable condition;
+    std::vector<Job>        jobs;
+    bool                    exiting = false;
+    std::thread             thread;
+
+    auto run() -> void;
+
+  public:
+    auto post(std::function<void()> function, std::chrono::milliseconds delay = {}) -> void;
+
+    Worker();
+    ~Worker();
+};
+} // namespace mikan
@@ -0,0 +1,77 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace test {
+// exit code which meson reports as skipped
+constexpr auto skipped = 77;
+
+// system dictionary directory, for tests which need a real model
+inline auto get_dictionary_path() -> const char* {
+    return std::getenv("MIKAN_TEST_DICTIONARY");
+}
+
+// a temporary configuration and cache directory for an Engine, with the test dictionary as the system one.
+// points XDG_CONFIG_HOME and XDG_CACHE_HOME to it, and removes it on destruction
+struct EngineHome {
+    std::filesystem::path dir;
+
+    auto write_config(const std::string_view name, const std::string_view contents) const -> void {
+        auto file = std::ofstream(dir / "config/mikan" / name, std::ios::binary | std::ios::trunc);
+        file << contents;
+    }
+
+    // configuration is appended to mikan.conf
+    EngineHome(const char* const dictionary, const std::string_view configuration)
+        : dir(std::filesystem::temp_directory_path() / std::format("mikan-test-{}", getpid())) {
+        std::filesystem::create_directories(dir / "config/mikan");
+        std::filesystem::create_directories(dir / "dic");
+        std::filesystem::create_directory_symlink(std::filesystem::absolute(dictionary), dir / "dic/system");
+        write_config("mikan.conf", std::format("dictionaries {}\n{}", (dir / "dic").string(), configuration));
+        setenv("XDG_CONFIG_HOME", (dir / "config").c_str(), 1);
+        setenv("XDG_CACHE_HOME", (dir / "cache").c_str(), 1);
+    }
+
+    ~EngineHome() {
+        auto error = std::error_code();
+        std::filesystem::remove_all(dir, error);
+    }
+};
+
+// one hiragana, three bytes in utf-8
+inline auto random_kana(std::mt19937& rng) -> std::string {
+    static constexpr const char* kana[] = {
+        "あ", "い", "う", "え", "お", "か", "き", "く", "け", "こ", "さ", "し", "す", "せ", "そ", "た", "ち", "つ", "て", "と",
+        "な", "に", "ぬ", "ね", "の", "は", "ひ", "ふ", "へ", "ほ", "ま", "み", "む", "め", "も", "や", "ゆ", "よ", "ら", "り",
+        "る", "れ", "ろ", "わ", "を", "ん", "が", "ぎ", "ぐ", "げ", "ご", "だ", "で", "ど", "ば", "び", "ぶ", "ぱ", "っ", "ょ",
+    };
+    return kana[rng() % std::size(kana)];
+}
+
+// runs function count times and returns the latencies sorted
+template <typename F>
+auto measure(const size_t count, F function) -> std::vector<std::chrono::duration<double, std::micro>> {
+    auto latencies = std::vector<std::chrono::duration<double, std::micro>>();
+    latencies.reserve(count);
+    for(auto i = 0uz; i < count; i += 1) {
+        const auto start = std::chrono::steady_clock::now();
+        function(i);
+        latencies.emplace_back(std::chrono::steady_clock::now() - start);
+    }
+    std::ranges::sort(latencies);
+    return latencies;
+}
+
+template <typename T>
+auto percentile(const std::vector<T>& sorted, const double p) -> T {
+    return sorted[std::min(sorted.size() - 1, size_t(double(sorted.size()) * p))];
+}
+} // namespace test
@@ -0,0 +1,105 @@
+// checks that the definitions log survives torn writes and reads logs of older versions
+#include <filesystem>
+#include <fstream>
+#include <print>
+
+#include <unistd.h>
+
+#include "defines-store.hpp"
+
+namespace {
+auto fails = 0;
+
+auto check(const bool condition, const std::string_view what) -> void {
+    if(!condition) {
+        std::println(stderr, "failed: {}", what);
+        fails += 1;
+    }
+}
+
+auto read_file(const std::string& path) -> std::string {
+    auto source = std::ifstream(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>());
+}
+
+auto write_file(const std::string& path, const std::string_view contents) -> void {
+    auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+using Definitions = mikan::engine::DefinesStore::Definitions;
+} // namespace
+
+auto main() -> int {
+    const auto dir  = std::filesystem::temp_directory_path() / std::format("mikan-defines-test-{}", getpid());
+    const auto path = (dir / "defines.txt").string();
+    std::filesystem::create_directories(dir);
+
+    // a log of older versions is converted
+    {
+        write_file(path, "かな,仮名\nへん,変\nbroken\n");
+        auto store = mikan::engine::DefinesStore();
+        check(store.open(path), "open legacy");
+        check(store.get_definitions() == Definitions{{"かな", {"仮名"}}, {"へん", {"変"}}}, "legacy definitions");
+        check(!read_file(path).contains("\nかな,"), "legacy log rewritten");
+    }
+
+    // definitions and tombstones are replayed
+    {
+        auto store = mikan::engine::DefinesStore();
+        check(store.open(path), "open");
+        check(store.add("かな", "カナ"), "add");
+        check(store.remove("へん"), "remove");
+        check(!store.remove("へん"), "remove twice");
+    }
+    const auto expected = Definitions{{"かな", {"仮名", "カナ"}}};
+    {
+        auto store = mikan::engine::DefinesStore();
+        check(store.open(path), "reopen");
+        check(store.get_definitions() == expected, "replayed definitions");
+    }
+
+    // a torn tombstone does not remove anything, and is cut off before the next append
+    const auto complete = read_file(path);
+    for(const auto torn : {"- 0123", "- 0123456789abcdef かな", "+ 0123456789abcdef かな,嘘"}) {
+        write_file(path, complete + torn);
+        auto store = mikan::engine::DefinesStore();
+        check(store.open(path), "open torn");
+        check(store.get_definitions() == expected, std::format("torn record {}", torn));
+        check(read_file(path) == complete, "torn record cut off");
+    }
+
+    // a corrupt record in the middle is skipped
+    {
+        write_file(path, complete + "+ 0000000000000000 かな,嘘\n");
+        auto store = mikan::engine::DefinesStore();
+        check(store.open(path), "open corrupt");
+        check(store.get_definitions() == expected, "corrupt record");
+        check(store.add("き", "木"), "add after corrupt");
+    }
+    {
+        auto store = mikan::engine::DefinesStore();
+        check(store.open(path), "reopen after corrupt");
+        check(store.get_definitions().contains("き"), "appended after corrupt");
+    }
+
+    // lines added by hand are read without a checksum
+    {
+        write_file(path, read_file(path) + "\nて,手\n");
+        auto store = mikan::engine::DefinesStore();
+        check(store.open(path), "open edited");
+        check(store.get_definitions().contains("て"), "definition added by hand");
+        check(store.get_definitions().contains("き"), "records kept after editing");
+    }
+
+    // a failed append does not leave an empty entry
+    {
+        auto store = mikan::engine::DefinesStore();
+        check(!store.add("な", "名"), "add before open");
+        check(store.get_definitions().empty(), "no entry on failure");
+    }
+
+    std::filesystem::remove_all(dir);
+    std::println("{} fails", fails);
+    return fails == 0 ? 0 : 1;
+}
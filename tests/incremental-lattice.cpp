@@ -0,0 +1,74 @@
+// checks that IncrementalLattice finds the same 1-best path as MeCab::Tagger while a sentence is edited
+#include <print>
+#include <random>
+
+#include "common.hpp"
+#include "incremental-lattice.hpp"
+
+namespace {
+auto parse_with_tagger(mikan::MeCabModel& model, const std::string& sentence) -> mikan::WordChain {
+    auto chain   = mikan::WordChain();
+    auto lattice = model.acquire_lattice();
+    lattice->set_request_type(MECAB_ONE_BEST);
+    lattice->set_sentence(sentence.data());
+    model.tagger->parse(lattice.get());
+    for(const auto* node = lattice->bos_node(); node; node = node->next) {
+        if(node->stat != MECAB_BOS_NODE && node->stat != MECAB_EOS_NODE) {
+            chain.emplace_back(mikan::Word::from_node(*node, nullptr));
+        }
+    }
+    return chain;
+}
+
+auto is_same_chain(const mikan::WordChain& a, const mikan::WordChain& b) -> bool {
+    return std::ranges::equal(a, b, [](const mikan::Word& a, const mikan::Word& b) { return a.raw() == b.raw() && a.feature() == b.feature(); });
+}
+} // namespace
+
+auto main() -> int {
+    const auto dictionary = test::get_dictionary_path();
+    if(!dictionary) {
+        return test::skipped;
+    }
+    auto model = std::make_shared<mikan::MeCabModel>(dictionary, nullptr, true);
+
+    // longer than the lookahead of the lattice, so that the reused prefix is not empty
+    constexpr auto sessions   = 50;
+    constexpr auto edits      = 400;
+    constexpr auto max_length = 150uz;
+
+    auto rng     = std::mt19937(1);
+    auto lattice = mikan::IncrementalLattice();
+    auto fails   = 0;
+    for(auto session = 0; session < sessions; session += 1) {
+        auto sentence = std::string();
+        for(auto edit = 0; edit < edits; edit += 1) {
+            const auto length = sentence.size() / 3;
+            const auto op     = rng() % 10;
+            if((op < 7 || length == 0) && length < max_length) {
+                // typing at the end
+                sentence += test::random_kana(rng);
+            } else if(op < 9) {
+                // backspace
+                sentence.resize(sentence.size() - 3);
+            } else {
+                // insertion in the middle
+                sentence.insert(rng() % (length + 1) * 3, test::random_kana(rng));
+            }
+            if(sentence.empty()) {
+                continue;
+            }
+            if(!lattice.parse(model, nullptr, sentence)) {
+                std::println(stderr, "parse failed: {}", sentence);
+                fails += 1;
+                continue;
+            }
+            if(!is_same_chain(lattice.best_path(), parse_with_tagger(*model, sentence))) {
+                std::println(stderr, "result differs: {}", sentence);
+                fails += 1;
+            }
+        }
+    }
+    std::println("{} sessions, {} fails", sessions, fails);
+    return fails == 0 ? 0 : 1;
+}
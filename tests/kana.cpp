@@ -0,0 +1,131 @@
+// checks the script conversions on every character of the hiragana and katakana blocks, and the romaji of kana text
+#include <print>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "kana.hpp"
+#include "romaji-index.hpp"
+#include "utf8.hpp"
+
+namespace {
+auto fails = 0;
+
+auto check(const std::string_view what, const std::string_view input, const std::string_view result, const std::string_view expected) -> void {
+    if(result != expected) {
+        std::println(stderr, "{} of \"{}\" is \"{}\", expected \"{}\"", what, input, result, expected);
+        fails += 1;
+    }
+}
+
+// the characters are all in the basic plane
+auto encode(const char32_t code) -> std::string {
+    if(code < 0x80) {
+        return std::string(1, char(code));
+    }
+    if(code < 0x800) {
+        return {char(0xc0 | code >> 6), char(0x80 | (code & 0x3f))};
+    }
+    return {char(0xe0 | code >> 12), char(0x80 | (code >> 6 & 0x3f)), char(0x80 | (code & 0x3f))};
+}
+
+auto to_codes(const std::string_view str) -> std::vector<char32_t> {
+    auto result = std::vector<char32_t>();
+    for(auto pos = 0uz; pos < str.size(); pos = mikan::utf8::next(str, pos)) {
+        result.push_back(mikan::utf8::decode(str, pos));
+    }
+    return result;
+}
+
+// U+FF61-FF9F in order, and what they are the half-width forms of
+constexpr auto half_width = std::string_view("｡｢｣､･ｦｧｨｩｪｫｬｭｮｯｰｱｲｳｴｵｶｷｸｹｺｻｼｽｾｿﾀﾁﾂﾃﾄﾅﾆﾇﾈﾉﾊﾋﾌﾍﾎﾏﾐﾑﾒﾓﾔﾕﾖﾗﾘﾙﾚﾛﾜﾝﾞﾟ");
+constexpr auto full_width = std::string_view("。「」、・ヲァィゥェォャュョッーアイウエオカキクケコサシスセソタチツテトナニヌネノハヒフヘホマミムメモヤユヨラリルレロワン゛゜");
+// the voiced katakana, each written with the half-width form of the first one and a sound mark
+constexpr auto voiced      = std::string_view("ガギグゲゴザジズゼゾダヂヅデドバビブベボヴヷヺ");
+constexpr auto voiced_base = std::string_view("カキクケコサシスセソタチツテトハヒフヘホウワヲ");
+constexpr auto semivoiced  = std::string_view("パピプペポ");
+constexpr auto semi_base   = std::string_view("ハヒフヘホ");
+} // namespace
+
+auto main() -> int {
+    // U+3041-3096 and the iteration marks U+309D-309E have a katakana 0x60 after them, the rest of both blocks are kept
+    const auto is_hiragana = [](const char32_t c) { return (c >= 0x3041 && c <= 0x3096) || c == 0x309d || c == 0x309e; };
+    const auto is_katakana = [](const char32_t c) { return (c >= 0x30a1 && c <= 0x30f6) || c == 0x30fd || c == 0x30fe; };
+
+    auto half_of = std::vector<std::string>(0x100);
+    {
+        const auto halves = to_codes(half_width);
+        const auto fulls  = to_codes(full_width);
+        for(auto i = 0uz; i < fulls.size(); i += 1) {
+            half_of[fulls[i] - 0x3000] = encode(halves[i]);
+        }
+        for(const auto& [marked, base, mark] : {std::tuple{voiced, voiced_base, "ﾞ"}, std::tuple{semivoiced, semi_base, "ﾟ"}}) {
+            const auto marks = to_codes(marked);
+            const auto bases = to_codes(base);
+            for(auto i = 0uz; i < marks.size(); i += 1) {
+                half_of[marks[i] - 0x3000] = half_of[bases[i] - 0x3000] + mark;
+            }
+        }
+    }
+
+    // every character alone and all of them in a row, with prefixes that move them to every alignment
+    auto all          = std::string();
+    auto all_katakana = std::string();
+    auto all_hiragana = std::string();
+    auto all_half     = std::string();
+    for(auto c = char32_t(0x3000); c < 0x3100; c += 1) {
+        const auto str      = encode(c);
+        const auto katakana = encode(is_hiragana(c) ? c + 0x60 : c);
+        const auto hiragana = encode(is_katakana(c) ? c - 0x60 : c);
+        const auto as_kata  = is_hiragana(c) ? c + 0x60 : c;
+        const auto half     = half_of[as_kata - 0x3000].empty() ? katakana : half_of[as_kata - 0x3000];
+
+        check("to_katakana", str, mikan::kana::to_katakana(str), katakana);
+        check("to_hiragana", str, mikan::kana::to_hiragana(str), hiragana);
+        check("to_half_katakana", str, mikan::kana::to_half_katakana(str), half);
+        all += str;
+        all_katakana += katakana;
+        all_hiragana += hiragana;
+        all_half += half;
+    }
+    for(const auto prefix : {"", "a", "ab"}) {
+        const auto str = prefix + all;
+        check("to_katakana", "the blocks", mikan::kana::to_katakana(str), prefix + all_katakana);
+        check("to_hiragana", "the blocks", mikan::kana::to_hiragana(str), prefix + all_hiragana);
+        check("to_half_katakana", "the blocks", mikan::kana::to_half_katakana(str), prefix + all_half);
+    }
+
+    // single hiragana are written with their own romaji, or kept
+    for(auto c = char32_t(0x3041); c < 0x30a0; c += 1) {
+        const auto str    = encode(c);
+        const auto romaji = mikan::kana_to_romaji(c);
+        check("kana_to_romaji", str, mikan::kana_to_romaji(str), romaji ? std::string(*romaji) : str);
+    }
+
+    struct Case {
+        const char* kana;
+        const char* romaji;
+    };
+    const auto cases = std::vector<Case>{
+        {"", ""},
+        {"かな", "kana"},
+        {"きゃっと", "kyatto"},
+        {"かった", "katta"},
+        {"まっちゃ", "mattya"},
+        {"っっか", "kkka"},
+        {"っあ", "ltua"},
+        {"あっ", "altu"},
+        {"っん", "ltunn"},
+        {"こんにちは", "konnnitiha"},
+        {"ふぁいる", "fairu"},
+        {"かな漢字", "kana漢字"},
+        {"っ漢", "ltu漢"},
+        {"abc", "abc"},
+    };
+    for(const auto& c : cases) {
+        check("kana_to_romaji", c.kana, mikan::kana_to_romaji(c.kana), c.romaji);
+    }
+
+    std::println("{} fails", fails);
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// parses from many threads sharing one model, and checks that pooled lattices give the same results as a fresh one
+#include <atomic>
+#include <print>
+#include <random>
+#include <thread>
+
+#include "common.hpp"
+#include "mecab-model.hpp"
+
+namespace {
+// surfaces and features of the best path, joined
+auto parse(MeCab::Tagger& tagger, MeCab::Lattice& lattice, const std::string& sentence) -> std::string {
+    lattice.set_request_type(MECAB_ONE_BEST);
+    lattice.set_sentence(sentence.data());
+    if(!tagger.parse(&lattice)) {
+        return {};
+    }
+    auto result = std::string();
+    for(const auto* node = lattice.bos_node(); node; node = node->next) {
+        result += std::string_view(node->surface, node->length);
+        result += '\t';
+        result += node->feature != nullptr ? node->feature : "";
+        result += '\n';
+    }
+    return result;
+}
+} // namespace
+
+auto main() -> int {
+    const auto dictionary = test::get_dictionary_path();
+    if(!dictionary) {
+        return test::skipped;
+    }
+    auto model = mikan::MeCabModel(dictionary, nullptr, true);
+
+    constexpr auto sentence_count = 64uz;
+    constexpr auto thread_count   = 16uz;
+    constexpr auto iterations     = 2000uz;
+
+    // expected results, from a lattice out of the pool
+    auto rng       = std::mt19937(1);
+    auto sentences = std::vector<std::string>(sentence_count);
+    auto expected  = std::vector<std::string>(sentence_count);
+    {
+        const auto lattice = std::unique_ptr<MeCab::Lattice>(model.model->createLattice());
+        for(auto i = 0uz; i < sentence_count; i += 1) {
+            for(auto n = 5 + rng() % 40; n > 0; n -= 1) {
+                sentences[i] += test::random_kana(rng);
+            }
+            expected[i] = parse(*model.tagger, *lattice, sentences[i]);
+        }
+    }
+
+    auto fails   = std::atomic_size_t(0);
+    auto threads = std::vector<std::thread>();
+    for(auto t = 0uz; t < thread_count; t += 1) {
+        threads.emplace_back([&, t] {
+            auto rng = std::mt19937(t);
+            for(auto i = 0uz; i < iterations; i += 1) {
+                const auto n = rng() % sentence_count;
+                // sometimes hold two lattices at once, like an n-best generator alive during a conversion
+                auto lattice = model.acquire_lattice();
+                auto extra   = rng() % 4 == 0 ? model.acquire_lattice() : mikan::MeCabModel::PooledLattice(nullptr, {&model});
+                if(parse(*model.tagger, *lattice, sentences[n]) != expected[n]) {
+                    fails += 1;
+                }
+                if(extra && parse(*model.tagger, *extra, sentences[(n + 1) % sentence_count]) != expected[(n + 1) % sentence_count]) {
+                    fails += 1;
+                }
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    // every lattice is back, and no more were created than could be held at once
+    const auto pooled = model.lattice_pool.size();
+    if(pooled == 0 || pooled > thread_count * 2) {
+        std::println(stderr, "unexpected pool size {}", pooled);
+        fails += 1;
+    }
+    std::println("{} threads, {} parses each, {} lattices pooled, {} fails", thread_count, iterations, pooled, fails.load());
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+// checks the prediction index against sorting every match, and that searches on an index of a million entries stay fast
+#include <algorithm>
+#include <chrono>
+#include <print>
+#include <random>
+#include <ranges>
+
+#include "common.hpp"
+#include "prediction-index.hpp"
+
+namespace {
+struct Entry {
+    std::string raw;
+    std::string converted;
+    uint32_t    weight;
+};
+
+// what search() returns, by sorting every entry
+auto search_all(const std::vector<Entry>& entries, const std::string_view prefix, const size_t limit) -> std::vector<std::pair<std::string_view, std::string_view>> {
+    auto matches = std::vector<const Entry*>();
+    for(const auto& entry : entries) {
+        if(entry.raw.starts_with(prefix)) {
+            matches.emplace_back(&entry);
+        }
+    }
+    // same order as the index, with duplicates merged into the highest weight
+    std::ranges::sort(matches, [](const Entry* a, const Entry* b) {
+        return std::tie(a->raw, a->converted, b->weight) < std::tie(b->raw, b->converted, a->weight);
+    });
+    const auto [first, last] = std::ranges::unique(matches, [](const Entry* a, const Entry* b) { return a->raw == b->raw && a->converted == b->converted; });
+    matches.erase(first, last);
+    std::ranges::stable_sort(matches, [](const Entry* a, const Entry* b) {
+        return a->weight != b->weight ? a->weight > b->weight : a->raw.size() < b->raw.size();
+    });
+
+    auto result = std::vector<std::pair<std::string_view, std::string_view>>();
+    for(const auto entry : matches | std::views::take(limit)) {
+        result.emplace_back(entry->raw, entry->converted);
+    }
+    return result;
+}
+
+auto make_entries(std::mt19937& rng, const size_t count) -> std::vector<Entry> {
+    auto entries = std::vector<Entry>(count);
+    for(auto& entry : entries) {
+        for(auto n = 1 + rng() % 6; n > 0; n -= 1) {
+            entry.raw += test::random_kana(rng);
+        }
+        entry.converted = std::format("{}", rng() % 100000);
+        entry.weight    = rng() % 4 == 0 ? rng() % 100 : 1;
+    }
+    return entries;
+}
+
+auto make_index(const std::vector<Entry>& entries) -> mikan::engine::PredictionIndex {
+    auto index = mikan::engine::PredictionIndex();
+    for(const auto& entry : entries) {
+        index.add(entry.raw, entry.converted, entry.weight);
+    }
+    index.finish();
+    return index;
+}
+} // namespace
+
+auto main() -> int {
+    auto rng   = std::mt19937(1);
+    auto fails = 0;
+
+    // exactness, on an index small enough to sort every match
+    {
+        const auto entries = make_entries(rng, 20'000);
+        const auto index   = make_index(entries);
+        for(auto i = 0; i < 500; i += 1) {
+            auto prefix = std::string();
+            for(auto n = rng() % 3; n > 0; n -= 1) {
+                prefix += test::random_kana(rng);
+            }
+            const auto limit    = 1 + rng() % 20;
+            const auto found    = index.search(prefix, limit);
+            const auto expected = search_all(entries, prefix, limit);
+            if(!std::ranges::equal(found, expected, [](const auto& a, const auto& b) { return a.raw == b.first && a.converted == b.second; })) {
+                std::println(stderr, "result differs: {} {}", prefix, limit);
+                fails += 1;
+            }
+        }
+    }
+
+    // latency with a million entries, where a short prefix matches tens of thousands of them
+    {
+        constexpr auto count = 1'000'000uz;
+        constexpr auto limit = 10uz;
+        // the target is a p99 under a millisecond, with room for debug builds and loaded machines
+        constexpr auto bound = std::chrono::duration<double, std::micro>(5'000);
+
+        const auto entries = make_entries(rng, count);
+        const auto index   = make_index(entries);
+        for(const auto length : {1, 2, 3}) {
+            auto prefixes = std::vector<std::string>(1000);
+            for(auto& prefix : prefixes) {
+                for(auto n = 0; n < length; n += 1) {
+                    prefix += test::random_kana(rng);
+                }
+            }
+            const auto latencies = test::measure(prefixes.size(), [&](const size_t i) { index.search(prefixes[i], limit); });
+            const auto p99       = test::percentile(latencies, 0.99);
+            std::println("{} entries, prefix of {} characters: p50 {:.1f}us, p99 {:.1f}us", index.size(), length, test::percentile(latencies, 0.5).count(), p99.count());
+            if(p99 > bound) {
+                std::println(stderr, "p99 of prefixes of {} characters over {:.0f}us", length, bound.count());
+                fails += 1;
+            }
+        }
+    }
+
+    std::println("{} fails", fails);
+    return fails == 0 ? 0 : 1;
+}
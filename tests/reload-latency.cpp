@@ -0,0 +1,95 @@
+// checks that Engine::compile_and_reload_user_dictionary_background() returns at once,
+// and that typing latency stays flat while the reload runs on the worker
+#include <print>
+#include <random>
+#include <thread>
+
+#include "common.hpp"
+#include "engine.hpp"
+
+namespace {
+using Latency   = std::chrono::duration<double, std::micro>;
+using Latencies = std::vector<Latency>;
+
+auto print_latencies(const std::string_view label, const Latencies& latencies) -> void {
+    std::println("{}: p50 {:.0f}us, p99 {:.0f}us, max {:.0f}us", label, test::percentile(latencies, 0.5).count(), test::percentile(latencies, 0.99).count(), latencies.back().count());
+}
+} // namespace
+
+auto main() -> int {
+    const auto dictionary = test::get_dictionary_path();
+    if(!dictionary) {
+        return test::skipped;
+    }
+
+    // an engine with the test dictionary as the system one, and a user dictionary to compile
+    const auto home = test::EngineHome(dictionary, "dictionary user.txt\nhistory_size 0\nvocabulary_warmup off\n");
+    home.write_config("user.txt", "みかん,蜜柑\nれいぶん,例文\nてすと,テスト\n");
+
+    auto share  = mikan::Share();
+    auto engine = mikan::engine::Engine(share);
+
+    // what a key press does, as in Context
+    auto rng      = std::mt19937(1);
+    auto lattice  = mikan::IncrementalLattice();
+    auto sentence = std::string();
+    auto fails    = 0;
+
+    const auto type_key = [&](size_t) {
+        if(sentence.size() >= 20 * 3) {
+            sentence.clear();
+        }
+        sentence += test::random_kana(rng);
+        if(engine.convert_wordchain({mikan::Word::from_raw(sentence)}, false, &lattice).empty()) {
+            fails += 1;
+        }
+    };
+
+    constexpr auto keys    = 3000uz;
+    constexpr auto reloads = 3;
+    constexpr auto timeout = std::chrono::seconds(60);
+
+    // let the reload of the startup finish
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    const auto idle = test::measure(keys, type_key);
+
+    // keep typing until each reload publishes a new model
+    auto blocked   = Latencies();
+    auto reloading = Latencies();
+    auto durations = Latencies();
+    for(auto i = 0; i < reloads; i += 1) {
+        const auto before = share.primary_vocabulary.load();
+        const auto start  = std::chrono::steady_clock::now();
+        engine.compile_and_reload_user_dictionary_background();
+        blocked.emplace_back(std::chrono::steady_clock::now() - start);
+        while(share.primary_vocabulary.load() == before) {
+            if(std::chrono::steady_clock::now() - start > timeout) {
+                std::println(stderr, "reload did not finish");
+                return 1;
+            }
+            std::ranges::copy(test::measure(100, type_key), std::back_inserter(reloading));
+        }
+        durations.emplace_back(std::chrono::steady_clock::now() - start);
+    }
+    std::ranges::sort(blocked);
+    std::ranges::sort(reloading);
+    std::ranges::sort(durations);
+
+    print_latencies("idle", idle);
+    print_latencies("reloading", reloading);
+    print_latencies("caller blocked", blocked);
+    print_latencies("reload", durations);
+    std::println("{} fails", fails);
+
+    // a reload on the calling thread would block the caller for the whole reload
+    if(blocked.back() > std::max(durations.front() / 4, Latency(1'000))) {
+        std::println(stderr, "caller blocked by the reload");
+        fails += 1;
+    }
+    const auto limit = std::max(test::percentile(idle, 0.99) * 10, Latency(20'000));
+    if(test::percentile(reloading, 0.99) > limit) {
+        std::println(stderr, "latency increased while reloading");
+        fails += 1;
+    }
+    return fails == 0 ? 0 : 1;
+}
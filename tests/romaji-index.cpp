@@ -0,0 +1,192 @@
+// checks the romaji automaton against the filter it replaced, and compares their speed on a typing loop
+#include <chrono>
+#include <print>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "romaji-index.hpp"
+
+namespace {
+enum class Kind {
+    Multi,
+    Invalid,
+    Empty,
+    Exact,
+};
+
+struct Result {
+    Kind                     kind;
+    const mikan::RomajiKana* exact = nullptr;
+
+    auto operator==(const Result&) const -> bool = default;
+};
+
+// the filter before the automaton, which narrows a list of entry indices on each character
+class LegacyRomajiIndex {
+  private:
+    std::vector<size_t> cache;
+    std::string         cache_source;
+
+    auto search_by_nth_chara(const char chara, const size_t n, const mikan::RomajiKana** const exact) const -> std::vector<size_t> {
+        auto r = std::vector<size_t>();
+        if(n == 0) {
+            for(auto i = std::begin(mikan::romaji_table); i < std::end(mikan::romaji_table); i += 1) {
+                const auto romaji = std::string_view(i->romaji);
+                if(romaji[0] == chara) {
+                    if(romaji.size() == n + 1) {
+                        *exact = i;
+                        return r;
+                    }
+                    r.emplace_back(i - std::begin(mikan::romaji_table));
+                }
+            }
+        } else {
+            for(const auto i : cache) {
+                const auto romaji = std::string_view(mikan::romaji_table[i].romaji);
+                if(romaji.size() <= n) {
+                    continue;
+                }
+                if(romaji[n] == chara) {
+                    if(romaji.size() == n + 1) {
+                        *exact = &mikan::romaji_table[i];
+                        return r;
+                    }
+                    r.emplace_back(i);
+                }
+            }
+        }
+        return r;
+    }
+
+  public:
+    auto filter(const std::string_view to_kana) -> Result {
+        if(to_kana.empty()) {
+            return {Kind::Invalid};
+        }
+        const auto use_cache = !cache_source.empty() && to_kana.size() == cache_source.size() + 1 && to_kana.starts_with(cache_source);
+
+        auto exact = (const mikan::RomajiKana*)nullptr;
+        if(!use_cache) {
+            cache.clear();
+            for(auto i = 0uz; i < to_kana.size() && exact == nullptr; i += 1) {
+                cache = search_by_nth_chara(to_kana[i], i, &exact);
+            }
+        } else {
+            cache = search_by_nth_chara(to_kana.back(), to_kana.size() - 1, &exact);
+        }
+        if(exact == nullptr && cache.empty()) {
+            return {Kind::Empty};
+        }
+        if(exact == nullptr && cache.size() == 1) {
+            exact = &mikan::romaji_table[cache[0]];
+        }
+        if(exact != nullptr) {
+            cache_source.clear();
+            return {Kind::Exact, exact};
+        }
+        cache_source = to_kana;
+        return {Kind::Multi};
+    }
+};
+
+auto filter(mikan::RomajiIndex& index, const std::string_view to_kana) -> Result {
+    auto result = index.filter(to_kana);
+    if(const auto exact = result.get<mikan::RomajiIndex::ExactOne>()) {
+        return {Kind::Exact, exact->result};
+    }
+    if(result.get<mikan::RomajiIndex::EmptyCache>()) {
+        return {Kind::Empty};
+    }
+    if(result.get<mikan::RomajiIndex::InvalidParam>()) {
+        return {Kind::Invalid};
+    }
+    return {Kind::Multi};
+}
+
+auto filter(LegacyRomajiIndex& index, const std::string_view to_kana) -> Result {
+    return index.filter(to_kana);
+}
+
+// the key handling of Context, returns the number of completed entries
+template <class Index>
+auto type_keys(Index& index, const std::string_view keys) -> size_t {
+    auto to_kana   = std::string();
+    auto completed = 0uz;
+    for(const auto c : keys) {
+        to_kana += c;
+        auto result = filter(index, to_kana);
+        if(result.kind == Kind::Empty) {
+            to_kana = c;
+            result  = filter(index, to_kana);
+            if(result.kind == Kind::Empty) {
+                to_kana.clear();
+                continue;
+            }
+        }
+        if(result.kind == Kind::Exact) {
+            completed += 1;
+            to_kana = result.exact->refill != nullptr ? result.exact->refill : "";
+        }
+    }
+    return completed;
+}
+
+template <class Index>
+auto measure_per_key(const std::string_view keys, size_t& completed) -> double {
+    auto       index = Index();
+    const auto start = std::chrono::steady_clock::now();
+    completed        = type_keys(index, keys);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / double(keys.size());
+}
+} // namespace
+
+auto main() -> int {
+    auto alphabet = std::string();
+    for(const auto& entry : mikan::romaji_table) {
+        for(auto p = entry.romaji; *p != '\0'; p += 1) {
+            if(!alphabet.contains(*p)) {
+                alphabet += *p;
+            }
+        }
+    }
+
+    // every input up to three characters, each from a fresh instance
+    auto fails  = 0;
+    auto inputs = std::vector<std::string>{""};
+    for(auto length = 1; length <= 3; length += 1) {
+        auto longer = std::vector<std::string>();
+        for(const auto& input : inputs) {
+            for(const auto c : alphabet) {
+                longer.emplace_back(input + c);
+            }
+        }
+        for(const auto& input : longer) {
+            auto index  = mikan::RomajiIndex();
+            auto legacy = LegacyRomajiIndex();
+            if(filter(index, input) != filter(legacy, input)) {
+                std::println(stderr, "result differs: {}", input);
+                fails += 1;
+            }
+        }
+        inputs = std::move(longer);
+    }
+
+    // typing random romaji, which keeps the cache of the legacy filter in use
+    auto rng  = std::mt19937(1);
+    auto keys = std::string();
+    while(keys.size() < 4'000'000) {
+        keys += mikan::romaji_table[rng() % std::size(mikan::romaji_table)].romaji;
+    }
+    auto       completed        = 0uz;
+    auto       legacy_completed = 0uz;
+    const auto automaton        = measure_per_key<mikan::RomajiIndex>(keys, completed);
+    const auto legacy           = measure_per_key<LegacyRomajiIndex>(keys, legacy_completed);
+    if(completed != legacy_completed) {
+        std::println(stderr, "typing results differ: {} and {}", completed, legacy_completed);
+        fails += 1;
+    }
+    std::println("{} keys: automaton {:.1f}ns per key, legacy filter {:.1f}ns per key", keys.size(), automaton, legacy);
+    std::println("{} fails", fails);
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+// checks the utf-8 functions against a simple decoder, on valid, truncated and invalid sequences
+#include <print>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "utf8.hpp"
+
+namespace {
+struct Character {
+    size_t   begin;
+    size_t   end;
+    char32_t code;
+};
+
+// a lead byte and up to 3 continuation bytes after it, or a stray continuation byte, per character.
+// decoded and checked by the code point ranges
+auto reference_decode(const std::string_view str) -> std::vector<Character> {
+    const auto is_continuation = [](const uint8_t c) { return (c & 0xc0) == 0x80; };
+
+    auto result = std::vector<Character>();
+    for(auto pos = 0uz; pos < str.size();) {
+        const auto lead = uint8_t(str[pos]);
+        auto       end  = pos + 1;
+        while(!is_continuation(lead) && end < str.size() && end < pos + 4 && is_continuation(uint8_t(str[end]))) {
+            end += 1;
+        }
+
+        auto code = mikan::utf8::replacement;
+        if(lead < 0x80) {
+            // continuation bytes after an ascii byte make it invalid
+            code = end - pos == 1 ? lead : mikan::utf8::replacement;
+        } else {
+            const auto length = lead >= 0xc0 && lead < 0xe0   ? 2uz
+                                : lead >= 0xe0 && lead < 0xf0 ? 3uz
+                                : lead >= 0xf0 && lead < 0xf8 ? 4uz
+                                                              : 0uz;
+            if(length != 0 && end - pos == length) {
+                auto value = char32_t(lead & (0x7f >> length));
+                for(auto i = pos + 1; i < end; i += 1) {
+                    value = value << 6 | (uint8_t(str[i]) & 0x3f);
+                }
+                // overlong forms, surrogates and code points over U+10FFFF are invalid
+                const auto min = length == 2 ? char32_t(0x80) : length == 3 ? char32_t(0x800) : char32_t(0x10000);
+                if(value >= min && value <= 0x10ffff && !(value >= 0xd800 && value <= 0xdfff)) {
+                    code = value;
+                }
+            }
+        }
+        result.emplace_back(Character{pos, end, code});
+        pos = end;
+    }
+    return result;
+}
+
+auto fails = 0;
+
+auto check(const std::string_view str) -> void {
+    const auto expected = reference_decode(str);
+    const auto hex      = [str] {
+        auto result = std::string();
+        for(const auto c : str) {
+            result += std::format("{:02x} ", unsigned(uint8_t(c)));
+        }
+        return result;
+    };
+    const auto fail = [&](const std::string_view what) {
+        std::println(stderr, "{} differs: {}", what, hex());
+        fails += 1;
+    };
+
+    auto valid = true;
+    auto pos   = 0uz;
+    for(const auto& character : expected) {
+        valid = valid && character.code != mikan::utf8::replacement;
+        if(mikan::utf8::next(str, pos) != character.end) {
+            return fail("next");
+        }
+        if(mikan::utf8::decode(str, pos) != character.code) {
+            return fail("decode");
+        }
+        pos = character.end;
+    }
+    for(auto i = expected.size(); i > 0; i -= 1) {
+        if(mikan::utf8::prev(str, expected[i - 1].end) != expected[i - 1].begin) {
+            return fail("prev");
+        }
+    }
+    if(mikan::utf8::validate(str) != valid) {
+        return fail("validate");
+    }
+    auto popped = std::string(str);
+    if(!expected.empty() && (mikan::utf8::pop_back(popped) != expected.back().code || popped.size() != expected.back().begin)) {
+        return fail("pop_back");
+    }
+}
+} // namespace
+
+auto main() -> int {
+    // every character of each length, at the boundaries of the ranges
+    const auto samples = std::vector<std::string>{
+        "a", "\x7f", "\xc2\x80", "\xc3\xa9", "\xdf\xbf",                                             // 1 and 2 bytes
+        "\xe0\xa0\x80", "\xe3\x81\x82", "\xed\x9f\xbf", "\xee\x80\x80", "\xef\xbf\xbf",              // 3 bytes
+        "\xf0\x90\x80\x80", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf",                                  // 4 bytes
+        "\xc0\x80", "\xc1\xbf", "\xe0\x80\x80", "\xe0\x9f\xbf", "\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf", // overlong
+        "\xed\xa0\x80", "\xed\xbf\xbf", "\xf4\x90\x80\x80", "\xf7\xbf\xbf\xbf",                      // surrogates and out of range
+        "\x80", "\xbf", "\xf8", "\xfe", "\xff",                                                      // not a lead byte
+        "\xe3\x81\x82\x80\x80\x80\x80\x80\x80",                                                      // a run of stray continuations
+    };
+    for(const auto& sample : samples) {
+        check(sample);
+        // truncated, alone and followed by others
+        for(auto size = 1uz; size < sample.size(); size += 1) {
+            const auto truncated = sample.substr(0, size);
+            check(truncated);
+            check(truncated + "a");
+            check("a" + truncated + "\xe3\x81\x82");
+        }
+        for(const auto& other : samples) {
+            check(sample + other);
+        }
+    }
+
+    // random byte strings, mostly ascii and kana so that the word-at-a-time paths of validate() are taken
+    auto rng = std::mt19937(1);
+    for(auto n = 0; n < 200'000; n += 1) {
+        auto str = std::string();
+        for(auto length = rng() % 24; length > 0; length -= 1) {
+            switch(rng() % 4) {
+            case 0:
+                str += char(rng() % 0x80);
+                break;
+            case 1:
+                str += samples[rng() % samples.size()];
+                break;
+            case 2:
+                str += char(rng() % 0x100);
+                break;
+            default:
+                str += "abcdefgh";
+                break;
+            }
+        }
+        check(str);
+    }
+
+    std::println("{} fails", fails);
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// counts heap allocations per keystroke on the typing path of Engine::convert_wordchain():
+// incremental parse, building the chain, caching it, applying the history, copying it into the candidate list and discarding the old ones
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <print>
+#include <random>
+#include <thread>
+
+#include "common.hpp"
+#include "engine.hpp"
+
+namespace {
+auto allocations = std::atomic_size_t(0);
+} // namespace
+
+auto operator new(const size_t size) -> void* {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(const auto ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+auto operator delete(void* const ptr) noexcept -> void {
+    std::free(ptr);
+}
+
+auto operator delete(void* const ptr, size_t) noexcept -> void {
+    std::free(ptr);
+}
+
+auto main() -> int {
+    const auto dictionary = test::get_dictionary_path();
+    if(!dictionary) {
+        return test::skipped;
+    }
+    const auto home   = test::EngineHome(dictionary, "vocabulary_warmup off\n");
+    auto       share  = mikan::Share();
+    auto       engine = mikan::engine::Engine(share);
+
+    constexpr auto sentences = 200;
+    constexpr auto length    = 30;
+
+    auto rng     = std::mt19937(1);
+    auto lattice = mikan::IncrementalLattice();
+
+    // what a key press does, as in Context
+    const auto type_key = [&](mikan::WordChain& chain, const std::string& kana) {
+        if(chain.empty()) {
+            chain.emplace_back(mikan::Word::from_raw(kana));
+        } else {
+            chain.back().raw() += kana;
+        }
+        chain = engine.convert_wordchain(chain, false, &lattice);
+    };
+
+    // commit some sentences first, so that the history is looked up with hits
+    for(auto n = 0; n < sentences; n += 1) {
+        auto chain = mikan::WordChain();
+        for(auto i = 0; i < length; i += 1) {
+            type_key(chain, test::random_kana(rng));
+        }
+        auto context = std::string();
+        for(const auto& word : chain) {
+            engine.record_selection(context, word);
+            context = word.feature();
+        }
+    }
+    // allocations are counted on every thread, let the refresh of the predictions after the selections finish
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    auto keystrokes = 0uz;
+    auto counted    = 0uz;
+    auto words      = 0uz;
+    for(auto n = 0; n < sentences; n += 1) {
+        auto chain = mikan::WordChain();
+        auto shown = mikan::WordChains();
+        for(auto i = 0; i < length; i += 1) {
+            const auto kana   = test::random_kana(rng);
+            const auto before = allocations.load();
+
+            type_key(chain, kana);
+            words += chain.size();
+            // the candidate list replaces the chains shown before
+            shown = mikan::WordChains{chain};
+
+            counted += allocations.load() - before;
+            keystrokes += 1;
+        }
+    }
+    std::println("{} keystrokes, {:.1f} words per chain, {:.1f} allocations per keystroke", keystrokes, double(words) / double(keystrokes), double(counted) / double(keystrokes));
+    return 0;
+}